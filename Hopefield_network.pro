@@ -11,6 +11,8 @@ QT       -= gui
 TARGET = Hopefield_network
 CONFIG   += console
 CONFIG   -= app_bundle
+CONFIG   += c++11
+CONFIG   += thread
 
 TEMPLATE = app
 
@@ -18,9 +20,44 @@ TEMPLATE = app
 SOURCES += main.cpp \
     network.cpp \
     temperaturemodule.cpp \
-    problems.cpp
+    problems.cpp \
+    weightstore.cpp \
+    kernels.cpp \
+    random.cpp \
+    acceptance.cpp \
+    replicaexchange.cpp \
+    threadpool.cpp \
+    ensemble.cpp \
+    replicabatch.cpp \
+    continuousnetwork.cpp \
+    meanfield.cpp \
+    mappedfile.cpp \
+    networkfile.cpp \
+    streamedweightstore.cpp \
+    tour.cpp \
+    decomposition.cpp \
+    tsplib.cpp \
+    warmstart.cpp
 
 HEADERS += \
     network.h \
     temperaturemodule.h \
-    problems.h
+    problems.h \
+    weightstore.h \
+    neuronstate.h \
+    kernels.h \
+    random.h \
+    acceptance.h \
+    replicaexchange.h \
+    threadpool.h \
+    ensemble.h \
+    replicabatch.h \
+    continuousnetwork.h \
+    meanfield.h \
+    mappedfile.h \
+    networkfile.h \
+    streamedweightstore.h \
+    tour.h \
+    decomposition.h \
+    tsplib.h \
+    warmstart.h
@@ -0,0 +1,25 @@
+#include "acceptance.h"
+
+#include <math.h>       /* exp, log, sqrt, ceil */
+
+// maximum of the absolute value of the second derivative of the sigmoid, 1/(6 sqrt 3)
+#define SIGMOID_MAX_CURVATURE 0.0962250448649376
+
+SigmoidTable::SigmoidTable(const double maxError):
+    m_maxError(maxError), m_limit(0), m_inverseStep(0), m_values()
+{
+    // past the limit the sigmoid is closer than maxError to 0 or 1
+    m_limit=log(1.0/maxError);
+
+    // linear interpolation errs by at most step^2/8 times the curvature
+    const double maxStep=sqrt(8.0*maxError/SIGMOID_MAX_CURVATURE);
+    const unsigned long intervals=m_limit>0 ? (unsigned long)ceil(2.0*m_limit/maxStep) : 1;
+    const double step=2.0*m_limit/intervals;
+    m_inverseStep=1.0/step;
+
+    m_values.reserve(intervals+2);
+    for (unsigned long i=0; i<=intervals; i++) m_values.push_back(1.0/(1.0+exp(m_limit-i*step)));
+
+    // guards reading past the last point when rounding puts an argument right at the limit
+    m_values.push_back(m_values.back());
+}
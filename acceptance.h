@@ -0,0 +1,78 @@
+#ifndef ACCEPTANCE_H
+#define ACCEPTANCE_H
+
+#include <vector>       /* vector */
+
+#include <math.h>       /* exp */
+
+using std::vector;
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// default bound of the error of tabulated probabilities
+#define DEFAULT_SIGMOID_ERROR 1e-6
+
+/**
+  * Ways of deciding the value of a neuron at nonzero temperature
+  */
+enum acceptanceMode
+{
+    EXACT_ACCEPTANCE = 0, // probability computed by exp
+    TABULATED_ACCEPTANCE // probability interpolated from a SigmoidTable
+};
+
+/**
+  * A table of the logistic sigmoid 1/(1+exp(-x)), linearly interpolated within a given error bound.
+  * Outside of the table the sigmoid is taken to be exactly 0 or 1.
+  */
+class SigmoidTable
+{
+private:
+    double m_maxError; // bound of the error of values
+    double m_limit; // the table covers (-limit, limit)
+    double m_inverseStep; // 1/distance of tabulated points
+    vector<double> m_values; // sigmoid at -limit, -limit+step, ..., limit
+
+public:
+    /**
+      * Constructor of class SigmoidTable
+      * @param1 bound of the error of values, less than 1 (default DEFAULT_SIGMOID_ERROR)
+      */
+    SigmoidTable(const double = DEFAULT_SIGMOID_ERROR);
+
+    inline double getMaxError() const {return m_maxError;}
+
+    /**
+      * Returns the sigmoid of a given argument.
+      * @param1 argument
+      * @return 1/(1+exp(-argument)) up to the error bound
+      */
+    inline double operator() (const double argument) const
+    {
+        if (argument>=m_limit) return 1.0;
+        if (argument<=-m_limit) return 0.0;
+
+        const double position=(argument+m_limit)*m_inverseStep;
+        const unsigned long index=(unsigned long)position;
+        const double fraction=position-index;
+        return m_values[index]+fraction*(m_values[index+1]-m_values[index]);
+    }
+};
+
+/**
+  * Decides whether a neuron is set TRUE at nonzero temperature, with probability 1/(1+exp(-argument)).
+  * @param1 argument, 2*potential/temperature
+  * @param2 random number uniform in [0, 1)
+  * @param3 acceptance mode
+  * @param4 table used by TABULATED_ACCEPTANCE
+  * @return value of the neuron
+  */
+inline bool isAccepted(const double argument, const double random, const acceptanceMode mode,
+                       const SigmoidTable* const table)
+{
+    if (mode==TABULATED_ACCEPTANCE) return random<(*table)(argument);
+
+    // the chance is one in 1+exp(-argument)
+    return random*(1+exp(-argument))<1.0;
+}
+
+#endif // ACCEPTANCE_H
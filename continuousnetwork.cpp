@@ -0,0 +1,138 @@
+#include "continuousnetwork.h"
+#include "threadpool.h"
+#include "kernels.h"
+
+#include <math.h>       /* log, fabs, sqrt */
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// bounds of the change of the time step of ADAPTIVE_INTEGRATION after a step
+#define MIN_STEP_SCALE 0.2
+#define MAX_STEP_SCALE 2.0
+
+ContinuousNetwork::ContinuousNetwork(const HopfieldNetwork& network, const double gain, const double timeConstant,
+                                     const uint64_t seed):
+    m_neuronWeights(network.getWeightStore()), m_neuronCount(network.getNeuronCount()),
+    m_inputs(network.getNeuronCount(), 0.0L), m_values(network.getNeuronCount(), 0.5L),
+    m_timeConstant(timeConstant), m_gain(gain), m_timeStep(DEFAULT_TIME_STEP), m_stepTolerance(DEFAULT_STEP_TOLERANCE),
+    m_convergenceRate(DEFAULT_CONVERGENCE_RATE), m_random(seed)
+{
+}
+
+void ContinuousNetwork::randomize(const double meanValue, const double noise)
+{
+    const double meanInput=log(meanValue/(1.0L-meanValue))/m_gain;
+    for (unsigned long i=0; i<m_neuronCount; i++) m_inputs[i]=meanInput+noise*(2.0L*m_random.nextDouble()-1.0L);
+    if (m_neuronCount) kernels::sigmoid(&m_values[0], &m_inputs[0], m_gain, m_neuronCount);
+}
+
+void ContinuousNetwork::calculateDerivatives(const vector<double>& inputs, const vector<double>& values,
+                                             vector<double>& derivatives, ThreadPool& pool) const
+{
+    // every thread takes a range of neurons
+    const unsigned long workerCount=pool.getThreadCount();
+    for (unsigned long t=0; t<workerCount; t++)
+    {
+        const unsigned long first=t*m_neuronCount/workerCount, last=(t+1)*m_neuronCount/workerCount;
+        pool.submit([this, &inputs, &values, &derivatives, first, last]
+        {
+            m_neuronWeights->calculateInputRange(values, derivatives, first, last);
+            const double decay=1.0L/m_timeConstant;
+            for (unsigned long i=first; i<last; i++) derivatives[i]-=decay*inputs[i];
+        });
+    }
+    pool.wait();
+}
+
+double ContinuousNetwork::step(const integrationMethod method, ThreadPool& pool)
+{
+    vector<double> derivatives(m_neuronCount);
+    vector<double> eulerInputs(m_neuronCount);
+    vector<double> newValues(m_neuronCount);
+
+    calculateDerivatives(m_inputs, m_values, derivatives, pool);
+
+    while (true)
+    {
+        for (unsigned long i=0; i<m_neuronCount; i++) eulerInputs[i]=m_inputs[i]+m_timeStep*derivatives[i];
+
+        const double timeStep=m_timeStep;
+        if (method==ADAPTIVE_INTEGRATION)
+        {
+            // Heun's step, the difference from Euler's one estimates the error
+            vector<double> eulerValues(m_neuronCount);
+            vector<double> eulerDerivatives(m_neuronCount);
+            kernels::sigmoid(&eulerValues[0], &eulerInputs[0], m_gain, m_neuronCount);
+            calculateDerivatives(eulerInputs, eulerValues, eulerDerivatives, pool);
+
+            double error=0.0;
+            for (unsigned long i=0; i<m_neuronCount; i++)
+            {
+                const double difference=fabs(eulerDerivatives[i]-derivatives[i]);
+                if (difference>error) error=difference;
+            }
+            error*=0.5L*timeStep;
+
+            double scale=error>0 ? 0.9L*sqrt(m_stepTolerance/error) : MAX_STEP_SCALE;
+            if (scale<MIN_STEP_SCALE) scale=MIN_STEP_SCALE;
+            if (scale>MAX_STEP_SCALE) scale=MAX_STEP_SCALE;
+            m_timeStep*=scale;
+
+            // retry a rejected step with the smaller time step
+            if (error>m_stepTolerance) continue;
+
+            for (unsigned long i=0; i<m_neuronCount; i++)
+            {
+                eulerInputs[i]=m_inputs[i]+0.5L*timeStep*(derivatives[i]+eulerDerivatives[i]);
+            }
+        }
+
+        m_inputs.swap(eulerInputs);
+        kernels::sigmoid(&newValues[0], &m_inputs[0], m_gain, m_neuronCount);
+
+        double change=0.0;
+        for (unsigned long i=0; i<m_neuronCount; i++)
+        {
+            const double difference=fabs(newValues[i]-m_values[i]);
+            if (difference>change) change=difference;
+        }
+        m_values.swap(newValues);
+        return change/timeStep;
+    }
+}
+
+bool ContinuousNetwork::compute(unsigned long* const maxSteps, const integrationMethod method,
+                                const unsigned int threadCount)
+{
+    if (!m_neuronCount) return true;
+
+    ThreadPool pool(threadCount);
+    unsigned long currentSteps=0;
+
+    while (maxSteps==NULL || *maxSteps==0 || currentSteps<*maxSteps)
+    {
+        currentSteps++;
+        if (step(method, pool)<m_convergenceRate)
+        {
+            // converged
+            if (maxSteps!=NULL && *maxSteps==0) *maxSteps=currentSteps;
+            return true;
+        }
+    }
+
+    // maxSteps used up
+    return false;
+}
+
+NeuronState ContinuousNetwork::getNeuronValues() const
+{
+    NeuronState result(m_neuronCount, false);
+    for (unsigned long i=0; i<m_neuronCount; i++) if (m_values[i]>0.5L) result.set(i, true);
+    return result;
+}
+
+HopfieldNetwork ContinuousNetwork::getNetwork() const
+{
+    vector<bool> neuronValues(m_neuronCount);
+    for (unsigned long i=0; i<m_neuronCount; i++) neuronValues[i]=m_values[i]>0.5L;
+    return HopfieldNetwork(m_neuronWeights, neuronValues);
+}
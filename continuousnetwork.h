@@ -0,0 +1,128 @@
+#ifndef CONTINUOUSNETWORK_H
+#define CONTINUOUSNETWORK_H
+
+#include <vector>       /* vector */
+#include <memory>       /* shared_ptr */
+
+#include "network.h"
+
+using std::vector;
+using std::shared_ptr;
+
+class ThreadPool;
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// defaults of the integration
+#define DEFAULT_TIME_STEP 1e-2
+#define DEFAULT_STEP_TOLERANCE 1e-3
+#define DEFAULT_CONVERGENCE_RATE 1e-4
+
+/**
+  * Ways of integrating a ContinuousNetwork
+  */
+enum integrationMethod
+{
+    EULER_INTEGRATION = 0, // explicit Euler with a fixed time step
+    ADAPTIVE_INTEGRATION // Heun with an Euler estimate of the error, adapting the time step to a tolerance
+};
+
+/**
+  * The continuous Hopfield-Tank model over the weights of a network: every neuron has an internal input u and
+  * a value v=1/(1+exp(-gain*u)) between 0 and 1, evolving by
+  *     du/dt = -u/tau + sum of weight[i][j]*v[j] over j!=i + bias.
+  * All neurons are integrated at once, the sums being computed on many threads by the weight store.
+  */
+class ContinuousNetwork
+{
+private:
+    shared_ptr<const WeightStore> m_neuronWeights;
+    unsigned long m_neuronCount;
+
+    vector<double> m_inputs; // internal inputs u
+    vector<double> m_values; // values v, kept in sync with m_inputs
+
+    double m_timeConstant; // tau
+    double m_gain;
+    double m_timeStep; // current time step, adapted by ADAPTIVE_INTEGRATION
+    double m_stepTolerance; // bound of the error of inputs in a step of ADAPTIVE_INTEGRATION
+    double m_convergenceRate; // the network has converged when no value changes faster
+
+    RandomGenerator m_random;
+
+    /**
+      * Calculates du/dt for given inputs and values.
+      * @param1 inputs
+      * @param2 values
+      * @param3 derivatives (output)
+      * @param4 pool of threads to use
+      */
+    void calculateDerivatives(const vector<double>&, const vector<double>&, vector<double>&, ThreadPool&) const;
+
+    /**
+      * Performs a step of integration, changing the time step if it is adaptive.
+      * @param1 method of integration
+      * @param2 pool of threads to use
+      * @return largest change of a value per unit of time
+      */
+    double step(const integrationMethod, ThreadPool&);
+
+public:
+    /**
+      * Constructor of class ContinuousNetwork. All inputs start at zero.
+      * @param1 network whose weights are shared
+      * @param2 gain of the sigmoid (default 1)
+      * @param3 time constant tau (default 1)
+      * @param4 seed
+      */
+    ContinuousNetwork(const HopfieldNetwork&, const double = 1.0L, const double = 1.0L, const uint64_t = 0);
+
+    inline unsigned long getNeuronCount() const {return m_neuronCount;}
+
+    inline const vector<double>& getValues() const {return m_values;}
+
+    inline double getTimeStep() const {return m_timeStep;}
+
+    /**
+      * Sets the (initial) time step.
+      */
+    inline void setTimeStep(const double timeStep) {m_timeStep=timeStep;}
+
+    /**
+      * Sets the bound of the error of inputs in a step of ADAPTIVE_INTEGRATION.
+      */
+    inline void setStepTolerance(const double tolerance) {m_stepTolerance=tolerance;}
+
+    /**
+      * Sets how slowly all values must change for the network to be considered converged.
+      * @param1 largest change of a value per unit of time
+      */
+    inline void setConvergenceRate(const double rate) {m_convergenceRate=rate;}
+
+    /**
+      * Sets the inputs around the one that gives a given value, e.g. 1/cityCount for a TSP network.
+      * @param1 mean value
+      * @param2 amplitude of uniform noise added to the inputs
+      */
+    void randomize(const double, const double);
+
+    /**
+      * Integrates the network until it converges or the (optional) maximum number of steps is reached.
+      * @param1 (pointer to) maximum number of steps - infinite if NULL(default) - stores the number of steps taken if 0
+      * @param2 method of integration (default EULER_INTEGRATION)
+      * @param3 number of threads (if left default, the number of cores)
+      * @return whether the network has converged
+      */
+    bool compute(unsigned long* const = NULL, const integrationMethod = EULER_INTEGRATION, const unsigned int = 0);
+
+    /**
+      * Returns the values rounded to binary ones, active above 1/2.
+      */
+    NeuronState getNeuronValues() const;
+
+    /**
+      * Returns a network with the shared weights in the rounded state, e.g. to decode it by getPath.
+      */
+    HopfieldNetwork getNetwork() const;
+};
+
+#endif // CONTINUOUSNETWORK_H
@@ -0,0 +1,278 @@
+#include "decomposition.h"
+#include "threadpool.h"
+
+#include <math.h>       /* hypot, ceil, HUGE_VAL */
+
+vector< vector<unsigned long> > problems::clusterCities(const TSPInstance& instance, const unsigned long clusterSize,
+                                                       const uint64_t seed)
+{
+    const unsigned long cityCount=instance.cityCount;
+    const unsigned long size=clusterSize ? clusterSize : 1;
+    const unsigned long clusterCount=cityCount ? (cityCount+size-1)/size : 0;
+
+    // distinct cities drawn as initial centres
+    RandomGenerator random(seed);
+    vector<unsigned long> cities(cityCount);
+    for (unsigned long i=0; i<cityCount; i++) cities[i]=i;
+    for (unsigned long i=0; i<clusterCount; i++) std::swap(cities[i], cities[i+random.nextBounded(cityCount-i)]);
+    const vector<unsigned long> centreCities(cities.begin(), cities.begin()+clusterCount);
+
+    vector<unsigned long> assignment(cityCount, 0);
+    if (!instance.hasCoordinates())
+    {
+        // every city joins the nearest centre
+        for (unsigned long city=0; city<cityCount; city++)
+        {
+            double nearest=HUGE_VAL;
+            for (unsigned long c=0; c<clusterCount; c++)
+            {
+                const double distance=instance.getDistance(city, centreCities[c]);
+                if (distance<nearest)
+                {
+                    nearest=distance;
+                    assignment[city]=c;
+                }
+            }
+        }
+    }
+    else
+    {
+        vector<double> xCentres(clusterCount), yCentres(clusterCount);
+        for (unsigned long c=0; c<clusterCount; c++)
+        {
+            xCentres[c]=instance.xCoordinates[centreCities[c]];
+            yCentres[c]=instance.yCoordinates[centreCities[c]];
+        }
+
+        for (unsigned long iteration=0; iteration<CLUSTERING_ITERATIONS; iteration++)
+        {
+            // assign cities to the nearest centres
+            bool changed=false;
+            for (unsigned long city=0; city<cityCount; city++)
+            {
+                double nearest=HUGE_VAL;
+                unsigned long nearestCentre=0;
+                for (unsigned long c=0; c<clusterCount; c++)
+                {
+                    const double dx=instance.xCoordinates[city]-xCentres[c], dy=instance.yCoordinates[city]-yCentres[c];
+                    if (dx*dx+dy*dy<nearest)
+                    {
+                        nearest=dx*dx+dy*dy;
+                        nearestCentre=c;
+                    }
+                }
+                if (iteration==0 || assignment[city]!=nearestCentre) changed=true;
+                assignment[city]=nearestCentre;
+            }
+            if (!changed) break;
+
+            // move the centres to the means of their cities, an empty cluster keeps its centre
+            vector<double> xSums(clusterCount, 0.0L), ySums(clusterCount, 0.0L);
+            vector<unsigned long> counts(clusterCount, 0);
+            for (unsigned long city=0; city<cityCount; city++)
+            {
+                xSums[assignment[city]]+=instance.xCoordinates[city];
+                ySums[assignment[city]]+=instance.yCoordinates[city];
+                counts[assignment[city]]++;
+            }
+            for (unsigned long c=0; c<clusterCount; c++)
+            {
+                if (!counts[c]) continue;
+                xCentres[c]=xSums[c]/counts[c];
+                yCentres[c]=ySums[c]/counts[c];
+            }
+        }
+    }
+
+    // gather the cities, dropping empty clusters; without coordinates, the centre comes first
+    vector< vector<unsigned long> > clusters(clusterCount);
+    if (!instance.hasCoordinates()) for (unsigned long c=0; c<clusterCount; c++) clusters[c].push_back(centreCities[c]);
+    for (unsigned long city=0; city<cityCount; city++)
+    {
+        if (instance.hasCoordinates() || city!=centreCities[assignment[city]]) clusters[assignment[city]].push_back(city);
+    }
+
+    vector< vector<unsigned long> > result;
+    for (unsigned long c=0; c<clusterCount; c++) if (!clusters[c].empty()) result.push_back(clusters[c]);
+    return result;
+}
+
+/**
+  * Solves the travelling salesman problem over some of the cities by a network annealed from the empty state,
+  * followed by solveTour.
+  * @param1 cities
+  * @param2 cities to visit
+  * @param3 seed of the network
+  * @return the cities to visit in order
+  */
+vector<unsigned long> solveCluster(const problems::TSPInstance& instance, const vector<unsigned long>& cities,
+                                   const uint64_t seed)
+{
+    const unsigned long cityCount=cities.size();
+    if (cityCount<=3) return cities;
+
+    // distances are scaled to the same mean, so that the penalty and temperature of every cluster are alike
+    problems::TSPInstance cluster;
+    cluster.cityCount=cityCount;
+    cluster.distances.resize(cityCount*cityCount);
+    double sum=0.0L;
+    for (unsigned long i=0; i<cityCount; i++)
+    {
+        for (unsigned long j=0; j<cityCount; j++)
+        {
+            cluster.distances[i*cityCount+j]=instance.getDistance(cities[i], cities[j]);
+            sum+=cluster.distances[i*cityCount+j];
+        }
+    }
+    const double scale=sum>0 ? CLUSTER_MEAN_DISTANCE*cityCount*(cityCount-1)/sum : 1.0L;
+    double largest=0.0L;
+    for (unsigned long i=0; i<cityCount*cityCount; i++)
+    {
+        cluster.distances[i]*=scale;
+        if (cluster.distances[i]>largest) largest=cluster.distances[i];
+    }
+
+    // the penalty outweighs any distance, so that the state settles into a tour rather than leaving cities out
+    const double delta=largest>0 ? CLUSTER_DELTA_FACTOR*largest : CLUSTER_DELTA_FACTOR*CLUSTER_MEAN_DISTANCE;
+    HopfieldNetwork network=problems::createTSP(cluster, delta);
+    network.setSeed(seed);
+    LogTemperatureModule module(CLUSTER_TEMPERATURE_FACTOR*delta);
+    network.uploadTemperatureModule(&module);
+    unsigned long maxSteps=CLUSTER_STEPS_PER_NEURON*network.getNeuronCount();
+    network.computeRandomly(&maxSteps);
+
+    const problems::TourResult tour=problems::solveTour(network, cluster);
+    vector<unsigned long> result(cityCount);
+    for (unsigned long i=0; i<cityCount; i++) result[i]=cities[tour.tour[i]];
+    return result;
+}
+
+problems::TourResult problems::solveByDecomposition(const TSPInstance& instance, const unsigned long clusterSize,
+                                                    const unsigned int threadCount, const uint64_t seed)
+{
+    TourResult result;
+    result.validState=false;
+    result.insertedCities=0;
+
+    const unsigned long targetSize=clusterSize>MIN_CLUSTER_SIZE ? clusterSize : MIN_CLUSTER_SIZE;
+    const vector< vector<unsigned long> > clusters=clusterCities(instance, targetSize, seed);
+    const unsigned long clusterCount=clusters.size();
+
+    // solve the clusters, every one with its own seed so that the result does not depend on the threads
+    RandomGenerator random(seed);
+    vector< vector<unsigned long> > clusterTours(clusterCount);
+    {
+        ThreadPool pool(threadCount);
+        for (unsigned long c=0; c<clusterCount; c++)
+        {
+            const uint64_t clusterSeed=random.next();
+            pool.submit([&instance, &clusters, &clusterTours, c, clusterSeed]
+            {
+                clusterTours[c]=solveCluster(instance, clusters[c], clusterSeed);
+            });
+        }
+        pool.wait();
+    }
+
+    // order the clusters by a tour of their centres: means of the coordinates, or the centre cities
+    TSPInstance centres;
+    centres.cityCount=clusterCount;
+    if (instance.hasCoordinates())
+    {
+        centres.xCoordinates.assign(clusterCount, 0.0L);
+        centres.yCoordinates.assign(clusterCount, 0.0L);
+        for (unsigned long c=0; c<clusterCount; c++)
+        {
+            for (unsigned long i=0; i<clusters[c].size(); i++)
+            {
+                centres.xCoordinates[c]+=instance.xCoordinates[clusters[c][i]]/clusters[c].size();
+                centres.yCoordinates[c]+=instance.yCoordinates[clusters[c][i]]/clusters[c].size();
+            }
+        }
+    }
+    centres.distances.resize(clusterCount*clusterCount);
+    for (unsigned long c=0; c<clusterCount; c++)
+    {
+        for (unsigned long d=0; d<clusterCount; d++)
+        {
+            centres.distances[c*clusterCount+d]=instance.hasCoordinates() ?
+                        hypot(centres.xCoordinates[c]-centres.xCoordinates[d], centres.yCoordinates[c]-centres.yCoordinates[d])
+                      : instance.getDistance(clusters[c][0], clusters[d][0]);
+        }
+    }
+    vector<unsigned long> order(clusterCount);
+    for (unsigned long c=0; c<clusterCount; c++) order[c]=c;
+    if (clusterCount>targetSize)
+    {
+        // too many clusters for one network, they are decomposed in turn
+        order=solveByDecomposition(centres, targetSize, threadCount, random.next()).tour;
+    }
+    else
+    {
+        order=solveCluster(centres, order, random.next());
+    }
+
+    // open the tour of every cluster at the edge whose removal, with the joins to the previous cluster and towards
+    // the next one, costs the least
+    vector<unsigned long> seamCities; // the entry and exit cities of every cluster and their neighbours in the tour
+    for (unsigned long position=0; position<clusterCount; position++)
+    {
+        const vector<unsigned long>& cycle=clusterTours[order[position]];
+        const vector<unsigned long>& nextCluster=clusters[order[(position+1)%clusterCount]];
+        const unsigned long size=cycle.size();
+        const bool first=(position==0), last=(position+1==clusterCount);
+
+        // cost of leaving the cluster from every city of it
+        vector<double> exitCosts(size, 0.0L);
+        for (unsigned long i=0; i<size && clusterCount>1; i++)
+        {
+            if (last)
+            {
+                exitCosts[i]=instance.getDistance(cycle[i], result.tour[0]);
+                continue;
+            }
+            exitCosts[i]=HUGE_VAL;
+            for (unsigned long j=0; j<nextCluster.size(); j++)
+            {
+                const double distance=instance.getDistance(cycle[i], nextCluster[j]);
+                if (distance<exitCosts[i]) exitCosts[i]=distance;
+            }
+        }
+
+        unsigned long bestEdge=0;
+        bool bestForward=true;
+        double bestCost=HUGE_VAL;
+        for (unsigned long i=0; i<size; i++)
+        {
+            const unsigned long a=cycle[i], b=cycle[(i+1)%size];
+            const double removed=size>1 ? instance.getDistance(a, b) : 0.0L;
+            for (unsigned int forward=0; forward<2; forward++)
+            {
+                // forward enters at b and leaves at a, backward enters at a and leaves at b
+                const unsigned long entry=forward ? b : a;
+                const double cost=(first ? 0.0L : instance.getDistance(result.tour.back(), entry))
+                        +exitCosts[forward ? i : (i+1)%size]-removed;
+                if (cost<bestCost)
+                {
+                    bestCost=cost;
+                    bestEdge=i;
+                    bestForward=forward;
+                }
+            }
+        }
+
+        const unsigned long start=result.tour.size();
+        for (unsigned long k=0; k<size; k++)
+        {
+            result.tour.push_back(bestForward ? cycle[(bestEdge+1+k)%size] : cycle[(bestEdge+size-k)%size]);
+        }
+        const unsigned long end=result.tour.size();
+        for (unsigned long k=start; k<end; k++) if (k<start+2 || k+2>=end) seamCities.push_back(result.tour[k]);
+    }
+
+    // the insides of the clusters are already improved by solveCluster, finding the nearest cities of all of
+    // them would take time quadratic in the number of cities
+    improveTour(result.tour, instance, DEFAULT_NEIGHBOUR_COUNT, seamCities);
+    result.length=getTourLength(result.tour, instance);
+    return result;
+}
@@ -0,0 +1,61 @@
+#ifndef DECOMPOSITION_H
+#define DECOMPOSITION_H
+
+#include <stdint.h>     /* uint64_t */
+
+#include "tour.h"
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// default number of cities of a cluster, the networks have its square of neurons
+#define DEFAULT_CLUSTER_SIZE 30
+
+// smallest cluster size used, smaller ones are raised to it so that the clusters are never ordered by a single
+// network over (nearly) all cities
+#define MIN_CLUSTER_SIZE 4
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// iterations of k-means clustering
+#define CLUSTERING_ITERATIONS 10
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// annealing of the network of a cluster: distances are scaled to this mean, the penalty is a multiple of the
+// largest scaled distance (smaller ones leave cities out of the state), the initial temperature a multiple of the
+// penalty, and the network runs for the given number of steps per neuron
+#define CLUSTER_MEAN_DISTANCE 50.0
+#define CLUSTER_DELTA_FACTOR 4.0
+#define CLUSTER_TEMPERATURE_FACTOR 0.3
+#define CLUSTER_STEPS_PER_NEURON 200
+
+namespace problems
+{
+
+/**
+  * Splits cities into spatial clusters of about a given size by k-means over their coordinates, or around cities
+  * drawn as centres if there are no coordinates.
+  * @param1 cities
+  * @param2 cluster size
+  * @param3 seed
+  * @return cities of every cluster, no cluster is empty
+  */
+vector< vector<unsigned long> > clusterCities(const TSPInstance&, const unsigned long, const uint64_t);
+
+/**
+  * Solves a large travelling salesman problem by decomposition: the cities are clustered, every cluster is solved
+  * by its own small network (annealed, then repaired and improved by solveTour) on a pool of threads, the order of
+  * clusters is solved in the same way over their centres (decomposed again if there are more clusters than the
+  * cluster size) and the tours of clusters are opened and stitched in that
+  * order where they join the next cluster best. At last the tour is improved from the cities at the seams, mending
+  * them without looking again at the insides of the clusters. Smaller clusters take less time, larger ones give
+  * better tours.
+  * @param1 cities
+  * @param2 cluster size (default DEFAULT_CLUSTER_SIZE, at least MIN_CLUSTER_SIZE)
+  * @param3 number of threads (if left default, the number of cores)
+  * @param4 seed
+  * @return tour and its length, validState is always FALSE
+  */
+TourResult solveByDecomposition(const TSPInstance&, const unsigned long = DEFAULT_CLUSTER_SIZE,
+                                const unsigned int = 0, const uint64_t = 0);
+
+}
+
+#endif // DECOMPOSITION_H
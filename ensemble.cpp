@@ -0,0 +1,71 @@
+#include "ensemble.h"
+#include "threadpool.h"
+
+#include <mutex>        /* mutex, lock_guard */
+#include <math.h>       /* HUGE_VAL */
+
+/**
+  * Runs one replica of an ensemble and records its outcome.
+  */
+static void runReplica(const HopfieldNetwork& network, const unsigned long replica, RandomGenerator random,
+                       const stateValidator validator, const unsigned long maxSteps, const double activeProbability,
+                       EnsembleResult& result, std::mutex& resultMutex)
+{
+    // the copy shares the weights, only its state is new
+    HopfieldNetwork copy(network);
+    copy.getRandomGenerator()=random.split();
+
+    NeuronState neuronValues(network.getNeuronCount(), false);
+    for (unsigned long i=0; i<neuronValues.size(); i++) if (random.nextDouble()<activeProbability) neuronValues.set(i, true);
+    copy.setNeuronValues(neuronValues);
+
+    shared_ptr<TemperatureModule> module(network.getTemperatureModule() ? network.getTemperatureModule()->clone() : NULL);
+    copy.uploadTemperatureModule(module.get());
+
+    unsigned long steps=maxSteps;
+    copy.computeRandomly(maxSteps ? &steps : NULL);
+
+    const double energy=copy.energy();
+    const bool valid=!validator || validator(copy);
+
+    std::lock_guard<std::mutex> lock(resultMutex);
+    result.finalEnergies[replica]=energy;
+    if (valid)
+    {
+        result.validCount++;
+        if (energy<result.bestEnergy || (energy==result.bestEnergy && replica<result.bestReplica))
+        {
+            result.bestFound=true;
+            result.bestReplica=replica;
+            result.bestEnergy=energy;
+            result.bestState=copy.getNeuronValues();
+            result.bestPath=copy.getPath();
+        }
+    }
+}
+
+EnsembleResult runEnsemble(const HopfieldNetwork& network, const unsigned long replicaCount,
+                           const unsigned int threadCount, const uint64_t seed, const stateValidator validator,
+                           const unsigned long maxSteps, const double activeProbability)
+{
+    EnsembleResult result;
+    result.bestFound=false;
+    result.bestReplica=0;
+    result.bestEnergy=HUGE_VAL;
+    result.finalEnergies.assign(replicaCount, HUGE_VAL);
+    result.validCount=0;
+    std::mutex resultMutex;
+
+    // seeds are handed out in order of replicas, so the result does not depend on the scheduling
+    RandomGenerator random(seed);
+    ThreadPool pool(threadCount);
+    for (unsigned long i=0; i<replicaCount; i++)
+    {
+        const RandomGenerator replicaRandom=random.split();
+        pool.submit([&network, i, replicaRandom, validator, maxSteps, activeProbability, &result, &resultMutex]
+        {runReplica(network, i, replicaRandom, validator, maxSteps, activeProbability, result, resultMutex);});
+    }
+    pool.wait();
+
+    return result;
+}
@@ -0,0 +1,41 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <vector>       /* vector */
+
+#include "network.h"
+
+using std::vector;
+
+/**
+  * Outcome of a run of an ensemble of replicas
+  */
+struct EnsembleResult
+{
+    bool bestFound; // whether some replica has finished in a valid state
+    unsigned long bestReplica; // replica that has found it, the first one among equal energies
+    double bestEnergy; // lowest final energy of a valid state
+    NeuronState bestState; // corresponding state
+    vector<unsigned long> bestPath; // corresponding path, as decoded by HopfieldNetwork::getPath
+    vector<double> finalEnergies; // final energy of every replica, valid or not, in order of replicas
+    unsigned long validCount; // number of replicas that have finished in a valid state
+};
+
+/**
+  * Runs independent replicas of a network from random states on a pool of threads and keeps the best final state.
+  * Every replica gets its own seed, initial state and copy of the temperature module of the network, while all of
+  * them share the weights.
+  * @param1 network defining the problem, with its temperature module if any
+  * @param2 number of replicas
+  * @param3 number of threads (if left default, the number of cores)
+  * @param4 seed of the ensemble
+  * @param5 validator of final states (if left default, every state is valid)
+  * @param6 maximum number of steps of every replica (if left default, runs until an equilibrium)
+  * @param7 probability that a neuron is initially active (default 0.5)
+  * @return best state and distribution of final energies
+  */
+EnsembleResult runEnsemble(const HopfieldNetwork&, const unsigned long, const unsigned int = 0,
+                           const uint64_t = 0, const stateValidator = NULL, const unsigned long = 0,
+                           const double = 0.5L);
+
+#endif // ENSEMBLE_H
@@ -0,0 +1,459 @@
+#include "kernels.h"
+#include "random.h"
+
+#include <math.h>       /* rint, sqrt, floor, ceil */
+#include <string.h>     /* memcpy, memcmp */
+
+#include <vector>       /* vector */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_KERNELS
+#include <immintrin.h>  /* AVX2 and AVX-512 intrinsics */
+#endif
+
+// a multiplication and an addition must not be fused by the compiler, even in kernels targeting instruction sets with
+// FMA, or they would round differently from the scalar kernels
+#ifdef __GNUC__
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// number of lanes of the reference summation order
+#define KERNEL_LANES 8
+
+// size of the pseudorandom data compared by checkKernels, not a multiple of any vector width
+#define CHECK_LENGTH 1003
+#define CHECK_ITERATIONS 50
+
+using std::vector;
+
+using namespace kernels;
+
+/**
+  * Loads bits of a state starting at any position.
+  * @param1 words of the state
+  * @param2 position of the first bit
+  * @param3 number of bits needed (at most 64, the rest is zero)
+  * @return bits
+  */
+static inline uint64_t loadBits(const uint64_t* bits, const unsigned long position, const unsigned long count)
+{
+    const unsigned long word=position/64, shift=position%64;
+    uint64_t result=bits[word]>>shift;
+    if (shift && count>64-shift) result|=bits[word+1]<<(64-shift);
+    if (count<64) result&=(uint64_t(1)<<count)-1;
+    return result;
+}
+
+/**
+  * Reduces the lanes of a sum in the reference order.
+  */
+static inline double reduceLanes(const double* lanes)
+{
+    return ((lanes[0]+lanes[1])+(lanes[2]+lanes[3]))+((lanes[4]+lanes[5])+(lanes[6]+lanes[7]));
+}
+
+static inline unsigned long minimum(const unsigned long a, const unsigned long b) {return a<b ? a : b;}
+
+static double maskedSumScalar(const double* weights, const uint64_t* bits, const unsigned long first, const unsigned long count)
+{
+    double lanes[KERNEL_LANES]={0, 0, 0, 0, 0, 0, 0, 0};
+
+    for (unsigned long k=0; k<count; k+=64)
+    {
+        // visit only the set bits, a weight that is not selected adds nothing to its lane
+        uint64_t mask=loadBits(bits, first+k, minimum(64, count-k));
+        while (mask)
+        {
+            const unsigned int position=__builtin_ctzll(mask);
+            lanes[position%KERNEL_LANES]+=weights[k+position];
+            mask&=mask-1;
+        }
+    }
+    return reduceLanes(lanes);
+}
+
+static void scaledAddScalar(double* target, const double factor, const double* weights, const unsigned long count)
+{
+    for (unsigned long k=0; k<count; k++) target[k]+=factor*weights[k];
+}
+
+static unsigned long maskedCountScalar(const uint64_t* first, const uint64_t* second, const unsigned long count)
+{
+    unsigned long result=0;
+    for (unsigned long k=0; k<count; k++) result+=__builtin_popcountll(first[k]&second[k]);
+    return result;
+}
+
+// exp(x)=2^n 2^f for x log2(e)=n+f, n an integer and |f|<=1/2, 2^f given by the Taylor polynomial of degree 7
+#define EXP_LOG2E 1.4426950408889634
+#define EXP_LIMIT 1020.0
+static const double s_exp2Coefficients[8]={1.0, 0.6931471805599453, 0.2402265069591007, 0.05550410866482158,
+                                            0.009618129107628477, 0.0013333558146428443, 1.5403530393381608e-4,
+                                            1.525273380405984e-5};
+
+static void sigmoidScalar(double* outputs, const double* inputs, const double gain, const unsigned long count)
+{
+    for (unsigned long k=0; k<count; k++)
+    {
+        double exponent=-gain*inputs[k]*EXP_LOG2E;
+        if (exponent>EXP_LIMIT) exponent=EXP_LIMIT;
+        if (exponent<-EXP_LIMIT) exponent=-EXP_LIMIT;
+
+        const double n=rint(exponent), f=exponent-n;
+        double power=s_exp2Coefficients[7];
+        for (int c=6; c>=0; c--) power=power*f+s_exp2Coefficients[c];
+
+        // 2^n is built from the exponent bits
+        const uint64_t bits=uint64_t((long long)n+1023)<<52;
+        double scale;
+        memcpy(&scale, &bits, sizeof(scale));
+        outputs[k]=1.0/(1.0+power*scale);
+    }
+}
+
+static void distanceRowScalar(float* distances, const double x, const double y, const double* xCoordinates,
+                              const double* yCoordinates, const unsigned long count, const double divisor,
+                              const distanceRounding rounding)
+{
+    for (unsigned long k=0; k<count; k++)
+    {
+        const double dx=x-xCoordinates[k], dy=y-yCoordinates[k];
+        double distance=sqrt((dx*dx+dy*dy)/divisor);
+        if (rounding==NEAREST_ROUNDING) distance=floor(distance+0.5);
+        else if (rounding==CEILING_ROUNDING) distance=ceil(distance);
+        distances[k]=(float)distance;
+    }
+}
+
+#ifdef X86_KERNELS
+
+// every CPU with AVX2 has the popcnt instruction
+__attribute__((target("popcnt")))
+static unsigned long maskedCountPopcnt(const uint64_t* first, const uint64_t* second, const unsigned long count)
+{
+    unsigned long result=0;
+    for (unsigned long k=0; k<count; k++) result+=__builtin_popcountll(first[k]&second[k]);
+    return result;
+}
+
+__attribute__((target("avx2")))
+static double maskedSumAVX2(const double* weights, const uint64_t* bits, const unsigned long first, const unsigned long count)
+{
+    const __m256i lowBits=_mm256_set_epi64x(8, 4, 2, 1);
+    const __m256i highBits=_mm256_set_epi64x(128, 64, 32, 16);
+    const bool deterministic=isDeterministic();
+
+    // even groups of eight weights go to accumulators 0 and 1, odd ones to 2 and 3 unless deterministic
+    __m256d accumulators[4]={_mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()};
+    const unsigned long fullCount=count/KERNEL_LANES*KERNEL_LANES;
+
+    for (unsigned long k=0; k<fullCount; k+=64)
+    {
+        const unsigned long chunk=minimum(64, fullCount-k);
+        const uint64_t mask=loadBits(bits, first+k, chunk);
+        if (!mask) continue;
+
+        for (unsigned long group=0; group*KERNEL_LANES<chunk; group++)
+        {
+            const long long byte=(mask>>(group*KERNEL_LANES))&0xFF;
+            if (!byte) continue; // adding zeros changes nothing
+
+            const __m256i selector=_mm256_set1_epi64x(byte);
+            const __m256d lowMask=_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(selector, lowBits), lowBits));
+            const __m256d highMask=_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(selector, highBits), highBits));
+            const double* groupWeights=weights+k+group*KERNEL_LANES;
+
+            const unsigned int target=(deterministic||!(group&1)) ? 0 : 2;
+            accumulators[target]=_mm256_add_pd(accumulators[target], _mm256_and_pd(_mm256_loadu_pd(groupWeights), lowMask));
+            accumulators[target+1]=_mm256_add_pd(accumulators[target+1], _mm256_and_pd(_mm256_loadu_pd(groupWeights+4), highMask));
+        }
+    }
+
+    double lanes[KERNEL_LANES];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(accumulators[0], accumulators[2]));
+    _mm256_storeu_pd(lanes+4, _mm256_add_pd(accumulators[1], accumulators[3]));
+
+    // the last incomplete group comes last in every lane
+    for (unsigned long k=fullCount; k<count; k++)
+    {
+        if (loadBits(bits, first+k, 1)) lanes[k%KERNEL_LANES]+=weights[k];
+    }
+    return reduceLanes(lanes);
+}
+
+__attribute__((target("avx2")))
+static void scaledAddAVX2(double* target, const double factor, const double* weights, const unsigned long count)
+{
+    const __m256d factors=_mm256_set1_pd(factor);
+    unsigned long k=0;
+
+    // multiply and add separately, a fused operation would round differently from the scalar kernel
+    for (; k+4<=count; k+=4)
+    {
+        const __m256d product=_mm256_mul_pd(factors, _mm256_loadu_pd(weights+k));
+        _mm256_storeu_pd(target+k, _mm256_add_pd(_mm256_loadu_pd(target+k), product));
+    }
+    for (; k<count; k++) target[k]+=factor*weights[k];
+}
+
+// the same operations as sigmoidScalar in the same order, four inputs at a time
+__attribute__((target("avx2")))
+static void sigmoidAVX2(double* outputs, const double* inputs, const double gain, const unsigned long count)
+{
+    const __m256d factor=_mm256_set1_pd(-gain), log2e=_mm256_set1_pd(EXP_LOG2E);
+    const __m256d upper=_mm256_set1_pd(EXP_LIMIT), lower=_mm256_set1_pd(-EXP_LIMIT), one=_mm256_set1_pd(1.0);
+    const __m256i bias=_mm256_set1_epi64x(1023);
+    unsigned long k=0;
+
+    for (; k+4<=count; k+=4)
+    {
+        __m256d exponent=_mm256_mul_pd(_mm256_mul_pd(factor, _mm256_loadu_pd(inputs+k)), log2e);
+        exponent=_mm256_max_pd(_mm256_min_pd(exponent, upper), lower);
+
+        const __m256d n=_mm256_round_pd(exponent, _MM_FROUND_TO_NEAREST_INT|_MM_FROUND_NO_EXC);
+        const __m256d f=_mm256_sub_pd(exponent, n);
+        __m256d power=_mm256_set1_pd(s_exp2Coefficients[7]);
+        for (int c=6; c>=0; c--) power=_mm256_add_pd(_mm256_mul_pd(power, f), _mm256_set1_pd(s_exp2Coefficients[c]));
+
+        const __m256i integer=_mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+        const __m256d scale=_mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(integer, bias), 52));
+        _mm256_storeu_pd(outputs+k, _mm256_div_pd(one, _mm256_add_pd(one, _mm256_mul_pd(power, scale))));
+    }
+    sigmoidScalar(outputs+k, inputs+k, gain, count-k);
+}
+
+// the same operations as distanceRowScalar, square roots and divisions being correctly rounded in both
+__attribute__((target("avx2")))
+static void distanceRowAVX2(float* distances, const double x, const double y, const double* xCoordinates,
+                            const double* yCoordinates, const unsigned long count, const double divisor,
+                            const distanceRounding rounding)
+{
+    const __m256d xs=_mm256_set1_pd(x), ys=_mm256_set1_pd(y), divisors=_mm256_set1_pd(divisor);
+    const __m256d half=_mm256_set1_pd(0.5);
+    unsigned long k=0;
+
+    for (; k+4<=count; k+=4)
+    {
+        const __m256d dx=_mm256_sub_pd(xs, _mm256_loadu_pd(xCoordinates+k));
+        const __m256d dy=_mm256_sub_pd(ys, _mm256_loadu_pd(yCoordinates+k));
+        __m256d distance=_mm256_sqrt_pd(_mm256_div_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+                                                      divisors));
+        if (rounding==NEAREST_ROUNDING)
+        {
+            distance=_mm256_round_pd(_mm256_add_pd(distance, half), _MM_FROUND_TO_NEG_INF|_MM_FROUND_NO_EXC);
+        }
+        else if (rounding==CEILING_ROUNDING)
+        {
+            distance=_mm256_round_pd(distance, _MM_FROUND_TO_POS_INF|_MM_FROUND_NO_EXC);
+        }
+        _mm_storeu_ps(distances+k, _mm256_cvtpd_ps(distance));
+    }
+    distanceRowScalar(distances+k, x, y, xCoordinates+k, yCoordinates+k, count-k, divisor, rounding);
+}
+
+__attribute__((target("avx512f")))
+static double maskedSumAVX512(const double* weights, const uint64_t* bits, const unsigned long first, const unsigned long count)
+{
+    const bool deterministic=isDeterministic();
+
+    // even groups of eight weights go to accumulator 0, odd ones to 1 unless deterministic
+    __m512d accumulators[2]={_mm512_setzero_pd(), _mm512_setzero_pd()};
+
+    for (unsigned long k=0; k<count; k+=64)
+    {
+        const unsigned long chunk=minimum(64, count-k);
+        const uint64_t mask=loadBits(bits, first+k, chunk);
+        if (!mask) continue;
+
+        for (unsigned long group=0; group*KERNEL_LANES<chunk; group++)
+        {
+            // weights that are not selected are neither loaded nor added, even past the end
+            const __mmask8 byte=(mask>>(group*KERNEL_LANES))&0xFF;
+            if (!byte) continue;
+
+            const unsigned int target=(deterministic||!(group&1)) ? 0 : 1;
+            accumulators[target]=_mm512_add_pd(accumulators[target],
+                                               _mm512_maskz_loadu_pd(byte, weights+k+group*KERNEL_LANES));
+        }
+    }
+
+    double lanes[KERNEL_LANES];
+    _mm512_storeu_pd(lanes, _mm512_add_pd(accumulators[0], accumulators[1]));
+    return reduceLanes(lanes);
+}
+
+__attribute__((target("avx512f")))
+static void scaledAddAVX512(double* target, const double factor, const double* weights, const unsigned long count)
+{
+    const __m512d factors=_mm512_set1_pd(factor);
+    unsigned long k=0;
+
+    for (; k+8<=count; k+=8)
+    {
+        const __m512d product=_mm512_mul_pd(factors, _mm512_loadu_pd(weights+k));
+        _mm512_storeu_pd(target+k, _mm512_add_pd(_mm512_loadu_pd(target+k), product));
+    }
+    for (; k<count; k++) target[k]+=factor*weights[k];
+}
+
+#endif // X86_KERNELS
+
+
+typedef double (*maskedSumKernel)(const double*, const uint64_t*, const unsigned long, const unsigned long);
+typedef void (*scaledAddKernel)(double*, const double, const double*, const unsigned long);
+typedef unsigned long (*maskedCountKernel)(const uint64_t*, const uint64_t*, const unsigned long);
+typedef void (*sigmoidKernel)(double*, const double*, const double, const unsigned long);
+typedef void (*distanceRowKernel)(float*, const double, const double, const double*, const double*, const unsigned long,
+                                  const double, const distanceRounding);
+
+static kernelSet s_kernels=SCALAR_KERNELS;
+static maskedSumKernel s_maskedSum=maskedSumScalar;
+static scaledAddKernel s_scaledAdd=scaledAddScalar;
+static maskedCountKernel s_maskedCount=maskedCountScalar;
+static sigmoidKernel s_sigmoid=sigmoidScalar;
+static distanceRowKernel s_distanceRow=distanceRowScalar;
+static bool s_deterministic=false;
+
+// select the fastest kernels before main
+static const bool s_kernelsSelected=selectKernels(getBestKernels());
+
+kernelSet kernels::getBestKernels()
+{
+#ifdef X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return AVX512_KERNELS;
+    if (__builtin_cpu_supports("avx2")) return AVX2_KERNELS;
+#endif
+    return SCALAR_KERNELS;
+}
+
+kernelSet kernels::getKernels()
+{
+    return s_kernels;
+}
+
+bool kernels::selectKernels(const kernelSet selected)
+{
+    if (selected>getBestKernels()) return false;
+
+    switch (selected)
+    {
+#ifdef X86_KERNELS
+    case AVX512_KERNELS:
+        s_maskedSum=maskedSumAVX512;
+        s_scaledAdd=scaledAddAVX512;
+        s_maskedCount=maskedCountPopcnt;
+        s_sigmoid=sigmoidAVX2;
+        s_distanceRow=distanceRowAVX2;
+        break;
+    case AVX2_KERNELS:
+        s_maskedSum=maskedSumAVX2;
+        s_scaledAdd=scaledAddAVX2;
+        s_maskedCount=maskedCountPopcnt;
+        s_sigmoid=sigmoidAVX2;
+        s_distanceRow=distanceRowAVX2;
+        break;
+#endif
+    default:
+        s_maskedSum=maskedSumScalar;
+        s_scaledAdd=scaledAddScalar;
+        s_maskedCount=maskedCountScalar;
+        s_sigmoid=sigmoidScalar;
+        s_distanceRow=distanceRowScalar;
+    }
+    s_kernels=selected;
+    return true;
+}
+
+void kernels::setDeterministic(const bool deterministic)
+{
+    s_deterministic=deterministic;
+}
+
+bool kernels::isDeterministic()
+{
+    return s_deterministic;
+}
+
+/**
+  * Computes with the selected kernels the results compared by checkKernels.
+  * @param1 weights
+  * @param2 words of the state
+  * @param3 factors of the iterations of scaledAdd
+  * @return sums of maskedSum at every offset, followed by the target of scaledAdd
+  */
+static vector<double> checkResults(const vector<double>& weights, const vector<uint64_t>& bits,
+                                   const vector<double>& factors)
+{
+    vector<double> result;
+    for (unsigned long offset=0; offset<2*KERNEL_LANES+1; offset++)
+    {
+        result.push_back(maskedSum(&weights[0]+offset, &bits[0], offset, CHECK_LENGTH-offset));
+    }
+
+    // the target is accumulated over many iterations, as the potentials are by flips
+    vector<double> target(CHECK_LENGTH, 0.0L);
+    for (unsigned long iteration=0; iteration<CHECK_ITERATIONS; iteration++)
+    {
+        const unsigned long offset=iteration%KERNEL_LANES;
+        scaledAdd(&target[0]+offset, factors[iteration], &weights[0], CHECK_LENGTH-offset);
+    }
+    result.insert(result.end(), target.begin(), target.end());
+    return result;
+}
+
+bool kernels::checkKernels()
+{
+    const kernelSet selected=s_kernels;
+    const bool deterministic=s_deterministic;
+
+    RandomGenerator random(CHECK_LENGTH);
+    vector<double> weights(CHECK_LENGTH), factors(CHECK_ITERATIONS);
+    vector<uint64_t> bits((CHECK_LENGTH+63)/64);
+    for (unsigned long k=0; k<CHECK_LENGTH; k++) weights[k]=(2.0L*random.nextDouble()-1.0L)*(1+random.nextBounded(1000));
+    for (unsigned long k=0; k<CHECK_ITERATIONS; k++) factors[k]=2.0L*random.nextDouble()-1.0L;
+    for (unsigned long k=0; k<bits.size(); k++) bits[k]=random.next();
+
+    s_deterministic=true;
+    selectKernels(SCALAR_KERNELS);
+    const vector<double> expected=checkResults(weights, bits, factors);
+
+    bool result=true;
+    for (int set=SCALAR_KERNELS+1; set<=getBestKernels(); set++)
+    {
+        selectKernels(static_cast<kernelSet>(set));
+        const vector<double> actual=checkResults(weights, bits, factors);
+        if (memcmp(&actual[0], &expected[0], expected.size()*sizeof(double))) result=false;
+    }
+
+    selectKernels(selected);
+    s_deterministic=deterministic;
+    return result;
+}
+
+double kernels::maskedSum(const double* weights, const uint64_t* bits, const unsigned long first, const unsigned long count)
+{
+    return s_maskedSum(weights, bits, first, count);
+}
+
+void kernels::scaledAdd(double* target, const double factor, const double* weights, const unsigned long count)
+{
+    s_scaledAdd(target, factor, weights, count);
+}
+
+unsigned long kernels::maskedCount(const uint64_t* first, const uint64_t* second, const unsigned long count)
+{
+    return s_maskedCount(first, second, count);
+}
+
+void kernels::sigmoid(double* outputs, const double* inputs, const double gain, const unsigned long count)
+{
+    s_sigmoid(outputs, inputs, gain, count);
+}
+
+void kernels::distanceRow(float* distances, const double x, const double y, const double* xCoordinates,
+                          const double* yCoordinates, const unsigned long count, const double divisor,
+                          const distanceRounding rounding)
+{
+    s_distanceRow(distances, x, y, xCoordinates, yCoordinates, count, divisor, rounding);
+}
@@ -0,0 +1,123 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdint.h>     /* uint64_t */
+
+/**
+  * Vectorised kernels of the inner loops of networks, dispatched at runtime according to the instruction sets
+  * supported by the CPU.
+  * All kernels sum in eight lanes, weight k going to lane k%8, and reduce the lanes in a fixed order. In
+  * deterministic mode the vectorised kernels keep exactly this order and give the same results as the scalar
+  * ones, otherwise they may use more lanes to hide latency.
+  */
+namespace kernels
+{
+
+/**
+  * Sets of kernels, from the slowest
+  */
+enum kernelSet
+{
+    SCALAR_KERNELS = 0,
+    AVX2_KERNELS,
+    AVX512_KERNELS
+};
+
+/**
+  * Roundings of distances computed by distanceRow
+  */
+enum distanceRounding
+{
+    NO_ROUNDING = 0,
+    NEAREST_ROUNDING, // halves up
+    CEILING_ROUNDING
+};
+
+/**
+  * Returns the fastest set of kernels supported by the CPU.
+  */
+kernelSet getBestKernels();
+
+/**
+  * Returns the set of kernels in use.
+  */
+kernelSet getKernels();
+
+/**
+  * Selects a set of kernels to use.
+  * @param1 set of kernels
+  * @return whether the set is supported by the CPU (if not, nothing is changed)
+  */
+bool selectKernels(const kernelSet);
+
+/**
+  * Turns the deterministic mode on or off (default off).
+  */
+void setDeterministic(const bool);
+
+bool isDeterministic();
+
+/**
+  * Checks that every set of kernels supported by the CPU gives in deterministic mode bit for bit the same results
+  * of maskedSum and scaledAdd as the scalar one, on pseudorandom weights and states. The selected set and the mode
+  * are restored afterwards; like selectKernels, it must not run while other threads use the kernels.
+  * @return whether all supported sets agree
+  */
+bool checkKernels();
+
+/**
+  * Sums the weights selected by the set bits of a state.
+  * @param1 weights
+  * @param2 words of the state
+  * @param3 position of the bit corresponding to the first weight
+  * @param4 number of weights
+  * @return sum of weights[k] for which bit first+k is set
+  */
+double maskedSum(const double*, const uint64_t*, const unsigned long, const unsigned long);
+
+/**
+  * Adds weights multiplied by a factor to a target.
+  * @param1 target
+  * @param2 factor
+  * @param3 weights
+  * @param4 number of weights
+  */
+void scaledAdd(double*, const double, const double*, const unsigned long);
+
+/**
+  * Counts the bits set in both of two bit strings.
+  * @param1 words of the first bit string
+  * @param2 words of the second bit string
+  * @param3 number of words
+  * @return number of common set bits
+  */
+unsigned long maskedCount(const uint64_t*, const uint64_t*, const unsigned long);
+
+/**
+  * Computes the logistic sigmoid 1/(1+exp(-gain*input)) of every input, exp being approximated with relative error
+  * below 1e-8 in the same way by all sets of kernels.
+  * @param1 outputs
+  * @param2 inputs
+  * @param3 gain
+  * @param4 number of inputs
+  */
+void sigmoid(double*, const double*, const double, const unsigned long);
+
+/**
+  * Computes the euclidean distances sqrt((dx*dx+dy*dy)/divisor) from a point to other points, rounded in the same
+  * way by all sets of kernels.
+  * @param1 distances (output)
+  * @param2 x coordinate of the point
+  * @param3 y coordinate of the point
+  * @param4 x coordinates of the other points
+  * @param5 y coordinates of the other points
+  * @param6 number of the other points
+  * @param7 divisor of the squared distance, 1 for the plain distance
+  * @param8 rounding of the distance before it is stored
+  */
+void distanceRow(float*, const double, const double, const double*, const double*, const unsigned long, const double,
+                 const distanceRounding);
+
+}
+
+#endif // KERNELS_H
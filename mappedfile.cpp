@@ -0,0 +1,45 @@
+#include "mappedfile.h"
+
+#include <sys/mman.h>   /* mmap, munmap, madvise */
+#include <sys/stat.h>   /* fstat */
+#include <fcntl.h>      /* open */
+#include <unistd.h>     /* close */
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char* path)
+{
+    close();
+
+    const int file=::open(path, O_RDONLY);
+    if (file<0) return false;
+
+    struct stat status;
+    if (fstat(file, &status) || status.st_size<=0)
+    {
+        ::close(file);
+        return false;
+    }
+
+    // a private mapping may be written, the pages written are copied
+    void* data=mmap(NULL, status.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+    ::close(file); // the mapping keeps the file open
+    if (data==MAP_FAILED) return false;
+
+    // weights are mostly read row by row
+    madvise(data, status.st_size, MADV_WILLNEED);
+
+    m_data=static_cast<char*>(data);
+    m_size=status.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (m_data) munmap(m_data, m_size);
+    m_data=NULL;
+    m_size=0;
+}
@@ -0,0 +1,43 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stddef.h>     /* size_t, NULL */
+
+/**
+  * A file mapped into memory as a whole. The mapping is private: the contents can be written, but changes stay in
+  * memory and never reach the file. It is released by the destructor, so whatever points into it has to keep the
+  * MappedFile alive.
+  */
+class MappedFile
+{
+private:
+    char* m_data;
+    size_t m_size;
+
+    // a mapping is shared, not copied
+    MappedFile(const MappedFile&);
+    MappedFile& operator= (const MappedFile&);
+
+public:
+    MappedFile():m_data(NULL), m_size(0){}
+    ~MappedFile();
+
+    /**
+      * Maps a file, releasing the previous mapping.
+      * @param1 path of the file
+      * @return whether the file has been mapped
+      */
+    bool open(const char*);
+
+    /**
+      * Releases the mapping.
+      */
+    void close();
+
+    inline bool isOpen() const {return m_data!=NULL;}
+
+    inline char* getData() const {return m_data;}
+    inline size_t getSize() const {return m_size;}
+};
+
+#endif // MAPPEDFILE_H
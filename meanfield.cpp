@@ -0,0 +1,140 @@
+#include "meanfield.h"
+#include "threadpool.h"
+#include "kernels.h"
+
+#include <math.h>       /* exp, fabs */
+
+MeanFieldAnnealing::MeanFieldAnnealing(const HopfieldNetwork& network, const unsigned long groupSize):
+    m_neuronWeights(network.getWeightStore()), m_neuronCount(network.getNeuronCount()),
+    m_groupSize(groupSize && network.getNeuronCount()%groupSize==0 ? groupSize : 0),
+    m_values(network.getNeuronCount(), m_groupSize ? 1.0L/m_groupSize : 0.5L),
+    m_damping(DEFAULT_MEAN_FIELD_DAMPING), m_tolerance(DEFAULT_MEAN_FIELD_TOLERANCE),
+    m_maxIterations(DEFAULT_MEAN_FIELD_ITERATIONS)
+{
+}
+
+void MeanFieldAnnealing::perturb(const double amplitude, const uint64_t seed)
+{
+    RandomGenerator random(seed);
+    for (unsigned long i=0; i<m_neuronCount; i++)
+    {
+        double value=m_values[i]+amplitude*(2.0L*random.nextDouble()-1.0L);
+        if (value<0.0L) value=0.0L;
+        if (value>1.0L) value=1.0L;
+        m_values[i]=value;
+    }
+}
+
+double MeanFieldAnnealing::iterate(const double temperature, ThreadPool& pool)
+{
+    // every thread takes a range of whole groups
+    const unsigned long workerCount=pool.getThreadCount();
+    const unsigned long unit=m_groupSize ? m_groupSize : 1;
+    const unsigned long unitCount=m_neuronCount/unit;
+    const double gain=2.0L/temperature;
+
+    vector<double> newValues(m_neuronCount);
+    vector<double> changes(workerCount, 0.0L);
+
+    for (unsigned long t=0; t<workerCount; t++)
+    {
+        const unsigned long first=t*unitCount/workerCount*unit, last=(t+1)*unitCount/workerCount*unit;
+        pool.submit([this, t, first, last, gain, &newValues, &changes]
+        {
+            if (first==last) return;
+
+            // potentials for the expected values, turned into new values in place
+            vector<double>& potentials=newValues;
+            m_neuronWeights->calculateInputRange(m_values, potentials, first, last);
+
+            if (!m_groupSize)
+            {
+                kernels::sigmoid(&newValues[0]+first, &potentials[0]+first, gain, last-first);
+            }
+            else
+            {
+                // softmax of gain*potential over every group, shifted by the largest one to avoid overflow
+                for (unsigned long group=first; group<last; group+=m_groupSize)
+                {
+                    double largest=potentials[group];
+                    for (unsigned long i=group+1; i<group+m_groupSize; i++) if (potentials[i]>largest) largest=potentials[i];
+
+                    double sum=0.0L;
+                    for (unsigned long i=group; i<group+m_groupSize; i++)
+                    {
+                        newValues[i]=exp(gain*(potentials[i]-largest));
+                        sum+=newValues[i];
+                    }
+                    for (unsigned long i=group; i<group+m_groupSize; i++) newValues[i]/=sum;
+                }
+            }
+
+            // move part of the way to the new values, which damps oscillations of the simultaneous update
+            double change=0.0L;
+            for (unsigned long i=first; i<last; i++)
+            {
+                const double difference=m_damping*(newValues[i]-m_values[i]);
+                if (fabs(difference)>change) change=fabs(difference);
+                newValues[i]=m_values[i]+difference;
+            }
+            changes[t]=change;
+        });
+    }
+    pool.wait();
+
+    m_values.swap(newValues);
+
+    double result=0.0L;
+    for (unsigned long t=0; t<workerCount; t++) if (changes[t]>result) result=changes[t];
+    return result;
+}
+
+bool MeanFieldAnnealing::compute(TemperatureModule& module, unsigned long* const maxSteps, const unsigned int threadCount)
+{
+    ThreadPool pool(threadCount);
+    unsigned long currentSteps=0;
+
+    while (module.isHot())
+    {
+        // iterate to a fixed point at the current temperature
+        const double temperature=module.getTemperature();
+        for (unsigned long iteration=0; iteration<m_maxIterations; iteration++)
+        {
+            if (maxSteps!=NULL && *maxSteps!=0 && currentSteps>=*maxSteps) return false; // maxSteps used up
+            currentSteps++;
+            if (iterate(temperature, pool)<m_tolerance) break;
+        }
+
+        // let as much time pass as a sweep of the binary network takes
+        for (unsigned long i=0; i<m_neuronCount; i++) module.coolDown();
+    }
+
+    if (maxSteps!=NULL && *maxSteps==0) *maxSteps=currentSteps;
+    return true;
+}
+
+NeuronState MeanFieldAnnealing::getNeuronValues() const
+{
+    NeuronState result(m_neuronCount, false);
+    if (!m_groupSize)
+    {
+        for (unsigned long i=0; i<m_neuronCount; i++) if (m_values[i]>0.5L) result.set(i, true);
+        return result;
+    }
+
+    for (unsigned long group=0; group<m_neuronCount; group+=m_groupSize)
+    {
+        unsigned long largest=group;
+        for (unsigned long i=group+1; i<group+m_groupSize; i++) if (m_values[i]>m_values[largest]) largest=i;
+        result.set(largest, true);
+    }
+    return result;
+}
+
+HopfieldNetwork MeanFieldAnnealing::getNetwork() const
+{
+    const NeuronState rounded=getNeuronValues();
+    vector<bool> neuronValues(m_neuronCount);
+    for (unsigned long i=0; i<m_neuronCount; i++) neuronValues[i]=rounded[i];
+    return HopfieldNetwork(m_neuronWeights, neuronValues);
+}
@@ -0,0 +1,98 @@
+#ifndef MEANFIELD_H
+#define MEANFIELD_H
+
+#include <vector>       /* vector */
+#include <memory>       /* shared_ptr */
+
+#include "network.h"
+
+using std::vector;
+using std::shared_ptr;
+
+class ThreadPool;
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// defaults of the iteration at every temperature
+#define DEFAULT_MEAN_FIELD_DAMPING 0.5
+#define DEFAULT_MEAN_FIELD_TOLERANCE 1e-4
+#define DEFAULT_MEAN_FIELD_ITERATIONS 1000
+
+/**
+  * Mean-field annealing: every neuron is replaced by its expected value at a given temperature,
+  * 1/(1+exp(-2*potential/temperature)) as in processNeuron, and all of them are iterated at once to a fixed point
+  * before the temperature is lowered by a TemperatureModule. There is no randomness and the neurons of an iteration
+  * are independent, so they are computed on many threads.
+  * Optionally, the neurons are normalised in consecutive groups by a softmax, so that the values of a group sum to
+  * one; for a TSP network with groups of cityCount neurons, every city is visited once.
+  */
+class MeanFieldAnnealing
+{
+private:
+    shared_ptr<const WeightStore> m_neuronWeights;
+    unsigned long m_neuronCount;
+    unsigned long m_groupSize; // size of groups normalised by softmax, 0 if none
+
+    vector<double> m_values; // expected values of neurons
+
+    double m_damping; // part of the new value taken in an iteration
+    double m_tolerance; // largest change of a value at a fixed point
+    unsigned long m_maxIterations; // at every temperature
+
+    /**
+      * Performs one iteration at a given temperature.
+      * @param1 temperature
+      * @param2 pool of threads to use
+      * @return largest change of a value
+      */
+    double iterate(const double, ThreadPool&);
+
+public:
+    /**
+      * Constructor of class MeanFieldAnnealing. Neurons start at 1/2, or at 1/groupSize with softmax.
+      * @param1 network whose weights are shared
+      * @param2 size of groups of consecutive neurons normalised by softmax (if left default, no softmax), must
+      * divide the number of neurons
+      */
+    MeanFieldAnnealing(const HopfieldNetwork&, const unsigned long = 0);
+
+    inline const vector<double>& getValues() const {return m_values;}
+
+    inline void setDamping(const double damping) {m_damping=damping;}
+
+    inline void setTolerance(const double tolerance) {m_tolerance=tolerance;}
+
+    /**
+      * Sets the maximal number of iterations at every temperature, after which the temperature is lowered anyway.
+      */
+    inline void setMaxIterations(const unsigned long maxIterations) {m_maxIterations=maxIterations;}
+
+    /**
+      * Adds uniform noise to the values to break their symmetry.
+      * @param1 amplitude
+      * @param2 seed
+      */
+    void perturb(const double, const uint64_t);
+
+    /**
+      * Anneals from the temperature of a module until it is no longer hot, iterating to a fixed point at every
+      * temperature it goes through.
+      * @param1 temperature module, cooled down neuronCount times after every fixed point
+      * @param2 (pointer to) maximum number of iterations - infinite if NULL(default) - stores the number taken if 0
+      * @param3 number of threads (if left default, the number of cores)
+      * @return whether the module has cooled down (a module that never cools down needs maxSteps)
+      */
+    bool compute(TemperatureModule&, unsigned long* const = NULL, const unsigned int = 0);
+
+    /**
+      * Returns the values rounded to binary ones: with softmax the largest value of every group, otherwise
+      * the values above 1/2.
+      */
+    NeuronState getNeuronValues() const;
+
+    /**
+      * Returns a network with the shared weights in the rounded state, e.g. to decode it by getPath.
+      */
+    HopfieldNetwork getNetwork() const;
+};
+
+#endif // MEANFIELD_H
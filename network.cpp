@@ -1,4 +1,9 @@
 #include "network.h"
+#include "threadpool.h"
+#include "networkfile.h"
+#include "streamedweightstore.h"
+
+#include <atomic>       /* atomic */
 #include "math.h"
 
 errorCode HopfieldNetwork::isInconsistent(const vector< vector<double> > neuronWeights, const vector<bool> neuronValues,
@@ -24,6 +29,14 @@ errorCode HopfieldNetwork::isInconsistent(const vector< vector<double> > neuronW
     return NO_ERROR;
 }
 
+errorCode HopfieldNetwork::isInconsistent(const shared_ptr<const WeightStore>& neuronWeights, const NeuronState& neuronValues)
+{
+    // weight stores are symmetric by construction, check consistency of sizes
+    if (!neuronWeights) return INCONSISTENCY;
+    if (neuronWeights->getNeuronCount()!=neuronValues.size()) return INCONSISTENCY;
+    return NO_ERROR;
+}
+
 bool HopfieldNetwork::updateNetwork(const vector< vector<double> > neuronWeights, const vector<bool> inNeuronValues,
                                     const unsigned long inNeuronCount)
 {
@@ -45,9 +58,40 @@ bool HopfieldNetwork::updateNetwork(const vector< vector<double> > neuronWeights
     else
     {
         // if consistent, update the network
-        m_neuronWeights=neuronWeights;
+        return updateNetwork(shared_ptr<const WeightStore>(new DenseWeightStore(neuronWeights)), neuronValues);
+    }
+
+    raiseError(UNKNOWN_ERROR);
+    return false;
+}
+
+bool HopfieldNetwork::updateNetwork(const shared_ptr<const WeightStore>& neuronWeights, const vector<bool>& inNeuronValues)
+{
+    // get neuronValues if left default
+    const NeuronState neuronValues = (inNeuronValues.empty() && neuronWeights) ?
+                NeuronState(neuronWeights->getNeuronCount(), true) : NeuronState(inNeuronValues);
+
+    // check consistency of input
+    errorCode error=isInconsistent(neuronWeights, neuronValues);
+
+    if (error)
+    {
+        // if inconsistent, raise an error and do nothing
+        raiseError(error);
+        return false;
+    }
+    else
+    {
+        // if consistent, update the network, switching to integer kernels if the weights allow it, unless they are
+        // used in place from a file, which a copy in memory would defeat
+        BitMaskWeightStore* bitMaskWeights=dynamic_cast<const BitMaskWeightStore*>(neuronWeights.get()) ||
+                    !neuronWeights->isInMemory() ? NULL : BitMaskWeightStore::create(*neuronWeights);
+        m_neuronWeights=bitMaskWeights ? shared_ptr<const WeightStore>(bitMaskWeights) : neuronWeights;
         m_neuronValues=neuronValues;
-        m_neuronCount=neuronCount;
+        m_neuronCount=neuronWeights->getNeuronCount();
+        m_colourOrder.clear();
+        m_colourStarts.clear();
+        resetPotentials();
         return true;
     }
 
@@ -55,142 +99,168 @@ bool HopfieldNetwork::updateNetwork(const vector< vector<double> > neuronWeights
     return false;
 }
 
+// a different seed for every network created without an explicit one, networks may be created on many threads
+inline uint64_t defaultSeed()
+{
+    static std::atomic<uint64_t> networksCreated(0);
+    return (uint64_t(time(NULL))<<20)^(networksCreated++);
+}
+
 HopfieldNetwork::HopfieldNetwork(const vector< vector<double> > neuronWeights,
                 const vector<bool> neuronValues, const unsigned long neuronCount):
-    m_neuronWeights(), m_neuronValues(), m_neuronCount(0), m_temperatureModule(NULL)
+    m_neuronWeights(), m_neuronValues(), m_neuronPotentials(), m_neuronCount(0), m_energy(0.0L),
+    m_flipsSinceRefresh(0), m_temperatureModule(NULL),
+    m_random(defaultSeed()), m_acceptanceMode(EXACT_ACCEPTANCE), m_sigmoidTable(), m_colourOrder(), m_colourStarts()
 {
-    static bool seedUsed=false;
-    if (!seedUsed)
-    {
-        srand (time(NULL));
-        seedUsed=true;
-    }
     // attempt to update the network, checking consistency
     updateNetwork(neuronWeights, neuronValues, neuronCount);
 }
 
+HopfieldNetwork::HopfieldNetwork(const shared_ptr<const WeightStore>& neuronWeights, const vector<bool>& neuronValues):
+    m_neuronWeights(), m_neuronValues(), m_neuronPotentials(), m_neuronCount(0), m_energy(0.0L),
+    m_flipsSinceRefresh(0), m_temperatureModule(NULL),
+    m_random(defaultSeed()), m_acceptanceMode(EXACT_ACCEPTANCE), m_sigmoidTable(), m_colourOrder(), m_colourStarts()
+{
+    // attempt to update the network, checking consistency
+    updateNetwork(neuronWeights, neuronValues);
+}
+
 double HopfieldNetwork::calculatePotential(const unsigned long neuron) const
 {
-    double potential=0;
+    return m_neuronWeights->calculatePotential(neuron, m_neuronValues);
+}
 
-    for (unsigned long i=0; i<m_neuronCount; i++)
+void HopfieldNetwork::resetPotentials()
+{
+    m_neuronPotentials.resize(m_neuronCount);
+    if (m_neuronWeights) m_neuronWeights->calculatePotentialRange(m_neuronValues, m_neuronPotentials, 0, m_neuronCount);
+    refreshEnergy();
+}
+
+void HopfieldNetwork::refreshEnergy()
+{
+    // an active neuron contributes by its bias and half of the weights of links to other active neurons
+    double result=0.0;
+    for (unsigned long i=m_neuronValues.findActive(0); i<m_neuronCount; i=m_neuronValues.findActive(i+1))
     {
-        if (i==neuron)
-        {
-            // weight[i][i] is -bias
-            potential+=m_neuronWeights[neuron][i];
-        }
-        else
-        {
-            // addend of the scalar product of weights and values vectors
-            potential+=m_neuronValues[i]*m_neuronWeights[neuron][i];
-        }
+        result-=0.5*(m_neuronPotentials[i]+m_neuronWeights->getWeight(i, i));
     }
-    return potential;
+    m_energy=result;
+    m_flipsSinceRefresh=0;
 }
 
-
-// return the number of bits of rand() result
-unsigned short randBits()
+void HopfieldNetwork::flipNeuron(const unsigned long neuron)
 {
-    unsigned short result=0;
-    bool done=false;
+    // the potential of the neuron includes its bias but not itself, the energy changes by it
+    m_energy+=m_neuronValues[neuron] ? m_neuronPotentials[neuron] : -m_neuronPotentials[neuron];
+    m_neuronValues.flip(neuron);
+
+    // the neuron contributes to the potential of every other neuron by its weight
+    m_neuronWeights->updatePotentials(neuron, m_neuronValues[neuron] ? 1.0L : -1.0L, m_neuronPotentials);
 
-    unsigned long tempMaxRand=RAND_MAX;
-    unsigned long bitPos=1;
-    while (bitPos)
+    if (++m_flipsSinceRefresh>=ENERGY_REFRESH_SWEEPS*m_neuronCount) refreshEnergy();
+}
+
+
+bool HopfieldNetwork::setNeuronValues(const NeuronState& neuronValues)
+{
+    if (neuronValues.size()!=m_neuronCount)
     {
-        if (tempMaxRand&bitPos)
-        {
-            if (done)
-            {
-                raiseError(RANDOMIZATION);
-                return 0;
-            }
-            else
-            {
-                // still a bit that is being randomized
-                result++;
-            }
-        }
-        bitPos=bitPos<<1;
+        raiseError(INCONSISTENCY);
+        return false;
     }
-    return result;
+    m_neuronValues=neuronValues;
+    resetPotentials();
+    return true;
 }
 
-// return a random number of any size
-template<typename T>
-inline T randomNumber()
+bool HopfieldNetwork::setNeuronValue(const unsigned long neuron, const bool value)
 {
-    const static unsigned short bitCount=randBits();
-    unsigned short bitsLeft=8*sizeof(T);
-    T result=0;
-    unsigned long temp;
-
-    while (bitsLeft>0)
+    if (neuron>=m_neuronCount)
     {
-        result=result<<bitCount;
-        bitsLeft-=bitCount;
-
-        temp=rand();
-        result=result|temp;
+        raiseError(OUT_OF_BOUNDS);
+        return false;
     }
-    return result;
+    if (value!=m_neuronValues[neuron]) flipNeuron(neuron);
+    return true;
 }
 
-/**
-  * Perform a Bernoulli trial.
-  * @param1 probability of success or its multiplicative inverse.
-  * @return result of the trial
-  */
-bool BernoulliTrial(double input)
+bool HopfieldNetwork::updateWeights(const vector<unsigned long>& neurons, const function<void (WeightStore&)>& change)
 {
-    unsigned long threshold=0;
-    unsigned long random=randomNumber<unsigned long>();
-
-    // probability 1 to succeed and 1 out of 1 is the same
-    if (input==1)
+    if (!m_neuronWeights || m_neuronWeights.use_count()>1)
     {
-        return true;
+        raiseError(INCONSISTENCY);
+        return false;
     }
-    else
+    for (unsigned long i=0; i<neurons.size(); i++)
     {
-        if (input>1)
-        {
-            // we want one try out of 'input' to be successful
-            threshold=ULONG_MAX/input;
-        }
-        else
+        if (neurons[i]>=m_neuronCount)
         {
-            threshold=ULONG_MAX*input;
-            // we want the probability to succeed to be 'input'
+            raiseError(OUT_OF_BOUNDS);
+            return false;
         }
     }
 
-    return (threshold>=random);
+    // the weights are owned by this network alone, it has created them as non-constant
+    for (unsigned long i=0; i<neurons.size(); i++)
+    {
+        if (m_neuronValues[neurons[i]]) m_neuronWeights->updatePotentials(neurons[i], -1.0L, m_neuronPotentials);
+    }
+    change(const_cast<WeightStore&>(*m_neuronWeights));
+    for (unsigned long i=0; i<neurons.size(); i++)
+    {
+        if (m_neuronValues[neurons[i]]) m_neuronWeights->updatePotentials(neurons[i], 1.0L, m_neuronPotentials);
+    }
+
+    // the given neurons also receive from the others by the new weights, runs of them are recalculated at once
+    vector<unsigned long> sorted=neurons;
+    std::sort(sorted.begin(), sorted.end());
+    for (unsigned long i=0; i<sorted.size();)
+    {
+        unsigned long last=i+1;
+        while (last<sorted.size() && sorted[last]<=sorted[last-1]+1) last++;
+        m_neuronWeights->calculatePotentialRange(m_neuronValues, m_neuronPotentials, sorted[i], sorted[last-1]+1);
+        i=last;
+    }
+
+    // the links may have changed, so may the colouring
+    m_colourOrder.clear();
+    m_colourStarts.clear();
+    refreshEnergy();
+    return true;
 }
 
+void HopfieldNetwork::setAcceptanceMode(const acceptanceMode mode, const double maxError)
+{
+    m_acceptanceMode=mode;
+    if (mode==TABULATED_ACCEPTANCE && (!m_sigmoidTable || m_sigmoidTable->getMaxError()!=maxError))
+    {
+        m_sigmoidTable=shared_ptr<const SigmoidTable>(new SigmoidTable(maxError));
+    }
+}
 
 errorCode HopfieldNetwork::processNeuron(const unsigned long neuron)
 {
     if (neuron<m_neuronCount)
     {
-        const double potential=calculatePotential(neuron);
+        const double potential=m_neuronPotentials[neuron];
         // if potential is zero, keep the value of the neuron
         if (potential)
         {
+            bool value;
             // if temperature module is set up
             if (m_temperatureModule&&m_temperatureModule->isHot())
             {
-                // the chance is oneInX
-                const double oneInX=1+exp((-2)*potential / m_temperatureModule->getTemperature());
-                m_neuronValues[neuron]=BernoulliTrial(oneInX);
+                value=sampleValue(potential, m_temperatureModule->getInverseTemperature(), m_random);
                 m_temperatureModule->coolDown();
             }
             else
             {
-                m_neuronValues[neuron]=(potential>=0);
+                value=(potential>=0);
             }
+
+            // only an actual change of the value costs an update of the potentials
+            if (value!=m_neuronValues[neuron]) flipNeuron(neuron);
         }
         return NO_ERROR;
     }
@@ -273,7 +343,7 @@ bool HopfieldNetwork::computeRandomly(unsigned long* const maxSteps)
     while (maxSteps==NULL || *maxSteps==0 || currentSteps<*maxSteps)
     {
         currentSteps++;
-        randomNeuron=rand()%m_neuronCount;
+        randomNeuron=m_random.nextBounded(m_neuronCount);
         priorValue=m_neuronValues[randomNeuron]; // get original value
         error = processNeuron(randomNeuron); // process the neuron
 
@@ -330,17 +400,74 @@ bool HopfieldNetwork::computeRandomly(unsigned long* const maxSteps)
     return false;
 }
 
-inline vector<unsigned long int> createRandomPermutation(const unsigned long elementsCount)
-
+inline vector<unsigned long int> createRandomPermutation(const unsigned long elementsCount, RandomGenerator& random)
 {
     vector<unsigned long int> result;
     result.reserve(elementsCount);
     for (unsigned long int i=0;i<elementsCount;i++) result.push_back(i); // identity permutation
-    random_shuffle(result.begin(), result.end()); // randomize to obtain a random permutation
+
+    // randomize by Fisher-Yates shuffle to obtain a random permutation
+    for (unsigned long int i=elementsCount;i>1;i--) std::swap(result[i-1], result[random.nextBounded(i)]);
 
     return result;
 }
 
+/**
+  * A set of neurons with insertion, removal and drawing of a random member in constant time.
+  */
+class NeuronSet
+{
+private:
+    vector<unsigned long> m_members;
+    vector<unsigned long> m_positions; // position of every neuron in m_members, ULONG_MAX if not a member
+
+public:
+    NeuronSet(const unsigned long neuronCount):m_members(), m_positions(neuronCount, ULONG_MAX){}
+
+    inline bool empty() const {return m_members.empty();}
+
+    inline void insert(const unsigned long neuron)
+    {
+        if (m_positions[neuron]!=ULONG_MAX) return;
+        m_positions[neuron]=m_members.size();
+        m_members.push_back(neuron);
+    }
+
+    inline void erase(const unsigned long neuron)
+    {
+        const unsigned long position=m_positions[neuron];
+        if (position==ULONG_MAX) return;
+
+        // the last member takes the place of the removed one
+        m_members[position]=m_members.back();
+        m_positions[m_members[position]]=position;
+        m_members.pop_back();
+        m_positions[neuron]=ULONG_MAX;
+    }
+
+    inline unsigned long draw(RandomGenerator& random) const {return m_members[random.nextBounded(m_members.size())];}
+};
+
+unsigned long HopfieldNetwork::processSweep()
+{
+    const vector<unsigned long int> permutation=createRandomPermutation(m_neuronCount, m_random);
+    unsigned long changed=0;
+
+    for (unsigned long elementIndex=0; elementIndex<m_neuronCount; elementIndex++)
+    {
+        // rows of weights are needed by the neurons that flip, a store on disk can read them ahead
+        if (elementIndex+ROW_PREFETCH_DISTANCE<m_neuronCount)
+        {
+            m_neuronWeights->prefetchRow(permutation[elementIndex+ROW_PREFETCH_DISTANCE]);
+        }
+        const unsigned long element=permutation[elementIndex];
+        const bool priorValue=m_neuronValues[element]; // get original value
+        processNeuron(element); // process the neuron, cannot be out of bounds
+        if (priorValue!=m_neuronValues[element]) changed++;
+    }
+    return changed;
+}
+
 bool HopfieldNetwork::computeRandomSeq(unsigned long* const maxSteps)
 {
     errorCode error=UNKNOWN_ERROR;
@@ -352,7 +479,7 @@ bool HopfieldNetwork::computeRandomSeq(unsigned long* const maxSteps)
 
     unsigned long elementIndex=0;
     unsigned long element=0;
-    vector<unsigned long int> permutation=createRandomPermutation(m_neuronCount);
+    vector<unsigned long int> permutation=createRandomPermutation(m_neuronCount, m_random);
 
     // process all neurons in random permutations
     while (maxSteps==NULL || *maxSteps==0 || currentSteps<*maxSteps)
@@ -367,7 +494,11 @@ bool HopfieldNetwork::computeRandomSeq(unsigned long* const maxSteps)
             }
             changed=false;
             elementIndex=0;
-            permutation=createRandomPermutation(m_neuronCount);
+            permutation=createRandomPermutation(m_neuronCount, m_random);
+        }
+        if (elementIndex+ROW_PREFETCH_DISTANCE<m_neuronCount)
+        {
+            m_neuronWeights->prefetchRow(permutation[elementIndex+ROW_PREFETCH_DISTANCE]);
         }
         element=permutation[elementIndex];
         priorValue=m_neuronValues[element]; // get original value
@@ -392,7 +523,611 @@ bool HopfieldNetwork::computeRandomSeq(unsigned long* const maxSteps)
 }
 
 
-istream& operator>> (istream& in, HopfieldNetwork& network)
+bool HopfieldNetwork::computeUnstable(unsigned long* const maxSteps)
+{
+    // a neuron is unstable if processing it at zero temperature would flip it
+    NeuronSet unstable(m_neuronCount);
+    for (unsigned long i=0; i<m_neuronCount; i++)
+    {
+        if (m_neuronValues[i] ? m_neuronPotentials[i]<0 : m_neuronPotentials[i]>0) unstable.insert(i);
+    }
+
+    vector<unsigned long> linkNeurons;
+    vector<double> linkWeights;
+    unsigned long currentSteps=0;
+
+    while (!unstable.empty())
+    {
+        if (maxSteps!=NULL && *maxSteps!=0 && currentSteps>=*maxSteps) return false; // maxSteps used up
+        currentSteps++;
+
+        const unsigned long neuron=unstable.draw(m_random);
+        flipNeuron(neuron);
+        unstable.erase(neuron);
+
+        // only the potentials of linked neurons have changed
+        m_neuronWeights->getLinks(neuron, linkNeurons, linkWeights);
+        for (unsigned long link=0; link<linkNeurons.size(); link++)
+        {
+            const unsigned long other=linkNeurons[link];
+            if (m_neuronValues[other] ? m_neuronPotentials[other]<0 : m_neuronPotentials[other]>0) unstable.insert(other);
+            else unstable.erase(other);
+        }
+    }
+
+    // equilibrium attained
+    if (maxSteps!=NULL && *maxSteps==0) *maxSteps=currentSteps;
+    return true;
+}
+
+/**
+  * A sum tree of the flip probabilities of neurons, drawing a neuron in proportion to them in logarithmic time.
+  * Every inner node is recalculated from its children, so the sums do not drift.
+  */
+class RateTree
+{
+private:
+    unsigned long m_leafCount; // a power of two
+    vector<double> m_nodes; // node i has children 2i and 2i+1, leaves start at m_leafCount
+
+public:
+    RateTree(const unsigned long neuronCount):m_leafCount(1), m_nodes()
+    {
+        while (m_leafCount<neuronCount) m_leafCount*=2;
+        m_nodes.assign(2*m_leafCount, 0.0L);
+    }
+
+    inline double total() const {return m_nodes[1];}
+
+    inline void set(unsigned long neuron, const double rate)
+    {
+        unsigned long node=m_leafCount+neuron;
+        m_nodes[node]=rate;
+        for (node/=2; node; node/=2) m_nodes[node]=m_nodes[2*node]+m_nodes[2*node+1];
+    }
+
+    /**
+      * Sets the rates of all neurons at once.
+      */
+    inline void assign(const vector<double>& rates)
+    {
+        std::fill(m_nodes.begin(), m_nodes.end(), 0.0L);
+        std::copy(rates.begin(), rates.end(), m_nodes.begin()+m_leafCount);
+        for (unsigned long node=m_leafCount-1; node; node--) m_nodes[node]=m_nodes[2*node]+m_nodes[2*node+1];
+    }
+
+    /**
+      * Finds the neuron in whose part of the total a given value falls.
+      */
+    inline unsigned long find(double value) const
+    {
+        unsigned long node=1;
+        while (node<m_leafCount)
+        {
+            if (value<m_nodes[2*node] || !m_nodes[2*node+1])
+            {
+                node=2*node;
+            }
+            else
+            {
+                value-=m_nodes[2*node];
+                node=2*node+1;
+            }
+        }
+        return node-m_leafCount;
+    }
+};
+
+// probability that a step of computeRandomly processing the neuron flips it, with the temperature frozen
+inline double flipRate(const double potential, const bool value, const bool hot, const double inverseTemperature)
+{
+    // if potential is zero, the value is kept
+    if (!potential) return 0.0L;
+    if (!hot) return (value ? potential<0 : potential>0) ? 1.0L : 0.0L;
+
+    // the chance of the value TRUE is one in 1+exp(-argument), of FALSE one in 1+exp(argument)
+    const double argument=2*potential*inverseTemperature;
+    return 1.0L/(1.0L+exp(value ? argument : -argument));
+}
+
+bool HopfieldNetwork::computeRejectionFree(unsigned long* const maxSteps, const double threshold)
+{
+    unsigned long currentSteps=0;
+
+    // above the threshold most steps flip the neuron anyway, take them one by one
+    while (m_temperatureModule && m_temperatureModule->isHot() && m_temperatureModule->getTemperature()>threshold)
+    {
+        if (maxSteps!=NULL && *maxSteps!=0 && currentSteps>=*maxSteps) return false; // maxSteps used up
+        currentSteps++;
+        processNeuron(m_random.nextBounded(m_neuronCount));
+    }
+
+    RateTree rates(m_neuronCount);
+    vector<double> allRates(m_neuronCount);
+    vector<unsigned long> linkNeurons;
+    vector<double> linkWeights;
+
+    bool hot=false;
+    double rateTemperature=0.0L; // temperature at which the rates have been calculated
+    double inverseTemperature=0.0L;
+    bool stale=true;
+
+    // processNeuron cools down only on a nonzero potential: a rejected step visits one of the nonzeroCount such
+    // neurons, whose rates sum to total, in proportion to their chances of rejection; a fraction of a step is kept
+    unsigned long nonzeroCount=0;
+    for (unsigned long i=0; i<m_neuronCount; i++) if (m_neuronPotentials[i]) nonzeroCount++;
+    double pendingCooling=0.0L;
+    const function<void (const double, const double)> coolRejected=[&](const double rejectedSteps, const double total)
+    {
+        if (total<m_neuronCount && nonzeroCount>total)
+        {
+            pendingCooling+=rejectedSteps*(nonzeroCount-total)/(m_neuronCount-total);
+        }
+        const unsigned long long wholeSteps=pendingCooling>=ULLONG_MAX ? ULLONG_MAX
+                                                                       : (unsigned long long)pendingCooling;
+        pendingCooling-=wholeSteps;
+        m_temperatureModule->advance(wholeSteps);
+    };
+
+    while (true)
+    {
+        if (maxSteps!=NULL && *maxSteps!=0 && currentSteps>=*maxSteps) return false; // maxSteps used up
+
+        if (!stale && m_temperatureModule)
+        {
+            // the rates depend on the temperature, which has been going down in the meantime
+            const bool nowHot=m_temperatureModule->isHot();
+            const double temperature=m_temperatureModule->getTemperature();
+            stale=(nowHot!=hot) || (hot && fabs(temperature-rateTemperature)>REJECTION_FREE_TOLERANCE*rateTemperature);
+        }
+        if (stale)
+        {
+            hot=m_temperatureModule && m_temperatureModule->isHot();
+            rateTemperature=hot ? m_temperatureModule->getTemperature() : 0.0L;
+            inverseTemperature=hot ? m_temperatureModule->getInverseTemperature() : 0.0L;
+            for (unsigned long i=0; i<m_neuronCount; i++)
+            {
+                allRates[i]=flipRate(m_neuronPotentials[i], m_neuronValues[i], hot, inverseTemperature);
+            }
+            rates.assign(allRates);
+            stale=false;
+        }
+
+        const double total=rates.total();
+        if (total<=0.0L)
+        {
+            // no neuron can flip, equilibrium attained
+            if (maxSteps!=NULL && *maxSteps==0) *maxSteps=currentSteps;
+            return true;
+        }
+
+        // a step flips a neuron with probability total/neuronCount, the rejected steps before it are geometric
+        const double chance=total/m_neuronCount;
+        unsigned long long steps=1;
+        if (chance<1.0L)
+        {
+            // a tiny chance gives more rejected steps than any counter holds, the count saturates rather than wraps
+            const double skipped=floor(log(1.0L-m_random.nextDouble())/log1p(-chance));
+            steps=skipped>=ULLONG_MAX-1 ? ULLONG_MAX : 1+(unsigned long long)skipped;
+        }
+        if (maxSteps!=NULL && *maxSteps!=0 && steps>*maxSteps-currentSteps)
+        {
+            // only rejected steps are left before maxSteps
+            if (hot) coolRejected(*maxSteps-currentSteps, total);
+            return false;
+        }
+        currentSteps=steps>ULONG_MAX-currentSteps ? ULONG_MAX : currentSteps+steps;
+
+        // the flipped neuron has a nonzero potential, the step flipping it cools down
+        if (hot)
+        {
+            m_temperatureModule->coolDown();
+            coolRejected(steps-1, total);
+        }
+
+        const unsigned long neuron=rates.find(m_random.nextDouble()*total);
+        m_neuronWeights->getLinks(neuron, linkNeurons, linkWeights);
+        for (unsigned long link=0; link<linkNeurons.size(); link++)
+        {
+            if (m_neuronPotentials[linkNeurons[link]]) nonzeroCount--;
+        }
+        flipNeuron(neuron);
+        rates.set(neuron, flipRate(m_neuronPotentials[neuron], m_neuronValues[neuron], hot, inverseTemperature));
+
+        // only the potentials of linked neurons have changed
+        for (unsigned long link=0; link<linkNeurons.size(); link++)
+        {
+            const unsigned long other=linkNeurons[link];
+            if (m_neuronPotentials[other]) nonzeroCount++;
+            rates.set(other, flipRate(m_neuronPotentials[other], m_neuronValues[other], hot, inverseTemperature));
+        }
+    }
+}
+
+void HopfieldNetwork::colourNeurons()
+{
+    vector<unsigned long> colours(m_neuronCount, 0);
+    vector<unsigned long> colourCounts;
+    vector<unsigned long> usedBy; // neuron that has last seen a colour among its neighbours
+    vector<unsigned long> linkNeurons;
+    vector<double> linkWeights;
+
+    // give every neuron the smallest colour that none of its already coloured neighbours has
+    for (unsigned long i=0; i<m_neuronCount; i++)
+    {
+        m_neuronWeights->getLinks(i, linkNeurons, linkWeights);
+        for (unsigned long link=0; link<linkNeurons.size(); link++)
+        {
+            if (linkNeurons[link]<i) usedBy[colours[linkNeurons[link]]]=i;
+        }
+
+        unsigned long colour=0;
+        while (colour<colourCounts.size() && usedBy[colour]==i) colour++;
+        if (colour==colourCounts.size())
+        {
+            colourCounts.push_back(0);
+            usedBy.push_back(m_neuronCount);
+        }
+        colours[i]=colour;
+        colourCounts[colour]++;
+    }
+
+    // sort neurons by colour
+    m_colourStarts.assign(1, 0);
+    for (unsigned long colour=0; colour<colourCounts.size(); colour++)
+    {
+        m_colourStarts.push_back(m_colourStarts.back()+colourCounts[colour]);
+    }
+    m_colourOrder.resize(m_neuronCount);
+    vector<unsigned long> positions(m_colourStarts.begin(), m_colourStarts.end()-1);
+    for (unsigned long i=0; i<m_neuronCount; i++) m_colourOrder[positions[colours[i]]++]=i;
+}
+
+vector<unsigned long> HopfieldNetwork::splitNeurons(const unsigned long parts) const
+{
+    vector<unsigned long> result;
+    for (unsigned long t=0; t<parts; t++)
+    {
+        const unsigned long start=(t*m_neuronCount/parts+STATE_WORD_BITS-1)/STATE_WORD_BITS*STATE_WORD_BITS;
+        result.push_back(start<m_neuronCount ? start : m_neuronCount);
+    }
+    result.push_back(m_neuronCount);
+    return result;
+}
+
+bool HopfieldNetwork::computeParallel(unsigned long* const maxSteps, const unsigned int threadCount)
+{
+    // CAN BE A SUBJECT OF OPTIMIZATION
+    // colours smaller than this are processed on the calling thread
+    const unsigned long MIN_PARALLEL_COLOUR=256;
+
+    if (m_colourStarts.empty()) colourNeurons();
+
+    ThreadPool pool(threadCount);
+    const unsigned long workerCount=pool.getThreadCount();
+
+    // every worker decides with its own random generator and owns a range of potentials
+    vector<RandomGenerator> randoms;
+    for (unsigned long t=0; t<workerCount; t++) randoms.push_back(m_random.split());
+    const vector<unsigned long> rangeStarts=splitNeurons(workerCount);
+
+    vector< vector<unsigned long> > flips(workerCount); // neurons to flip, found by every worker
+    vector< vector<double> > flipFactors(workerCount); // +1 for activation, -1 for deactivation
+
+    unsigned long currentSteps=0;
+    bool changed=false;
+
+    while (true)
+    {
+        changed=false;
+        for (unsigned long colour=0; colour+1<m_colourStarts.size(); colour++)
+        {
+            if (maxSteps!=NULL && *maxSteps!=0 && currentSteps>=*maxSteps) return false; // maxSteps used up
+
+            const unsigned long* neurons=&m_colourOrder[0]+m_colourStarts[colour];
+            const unsigned long colourSize=m_colourStarts[colour+1]-m_colourStarts[colour];
+            currentSteps+=colourSize;
+
+            if (colourSize<MIN_PARALLEL_COLOUR)
+            {
+                // not worth the synchronisation, neurons of one colour can still be processed in any order
+                for (unsigned long i=0; i<colourSize; i++)
+                {
+                    const bool priorValue=m_neuronValues[neurons[i]];
+                    processNeuron(neurons[i]);
+                    if (priorValue!=m_neuronValues[neurons[i]]) changed=true;
+                }
+                continue;
+            }
+
+            // the temperature stays the same within a colour, cooling down follows for every neuron processed
+            const bool hot=m_temperatureModule&&m_temperatureModule->isHot();
+            const double inverseTemperature=hot ? m_temperatureModule->getInverseTemperature() : 0.0L;
+
+            // decide new values, nothing is written to the shared state
+            for (unsigned long t=0; t<workerCount; t++)
+            {
+                pool.submit([this, t, workerCount, neurons, colourSize, hot, inverseTemperature,
+                            &randoms, &flips, &flipFactors]
+                {
+                    flips[t].clear();
+                    flipFactors[t].clear();
+                    for (unsigned long i=t*colourSize/workerCount; i<(t+1)*colourSize/workerCount; i++)
+                    {
+                        const unsigned long neuron=neurons[i];
+                        const double potential=m_neuronPotentials[neuron];
+                        // if potential is zero, keep the value of the neuron
+                        if (!potential) continue;
+
+                        const bool value=hot ? sampleValue(potential, inverseTemperature, randoms[t]) : (potential>=0);
+                        if (value!=m_neuronValues[neuron])
+                        {
+                            flips[t].push_back(neuron);
+                            flipFactors[t].push_back(value ? 1.0L : -1.0L);
+                        }
+                    }
+                });
+            }
+            pool.wait();
+
+            if (hot) for (unsigned long i=0; i<colourSize; i++) m_temperatureModule->coolDown();
+
+            unsigned long flipCount=0;
+            for (unsigned long t=0; t<workerCount; t++) flipCount+=flips[t].size();
+            if (!flipCount) continue;
+            changed=true;
+
+            // neurons of a colour are not linked, their flips change the energy independently
+            for (unsigned long t=0; t<workerCount; t++)
+            {
+                for (unsigned long i=0; i<flips[t].size(); i++) m_energy-=flipFactors[t][i]*m_neuronPotentials[flips[t][i]];
+            }
+            m_flipsSinceRefresh+=flipCount;
+
+            // apply the flips, every worker to its own range of neurons
+            for (unsigned long t=0; t<workerCount; t++)
+            {
+                pool.submit([this, t, workerCount, &rangeStarts, &flips, &flipFactors]
+                {
+                    const unsigned long first=rangeStarts[t], last=rangeStarts[t+1];
+                    for (unsigned long source=0; source<workerCount; source++)
+                    {
+                        for (unsigned long i=0; i<flips[source].size(); i++)
+                        {
+                            const unsigned long neuron=flips[source][i];
+                            if (neuron>=first && neuron<last) m_neuronValues.flip(neuron);
+                            m_neuronWeights->updatePotentialRange(neuron, flipFactors[source][i], m_neuronPotentials,
+                                                                  first, last);
+                        }
+                    }
+                });
+            }
+            pool.wait();
+            if (m_flipsSinceRefresh>=ENERGY_REFRESH_SWEEPS*m_neuronCount) refreshEnergy();
+        }
+
+        // equilibrium attained if a whole sweep has changed nothing
+        if (!changed)
+        {
+            if (maxSteps!=NULL && *maxSteps==0) *maxSteps=currentSteps;
+            return true;
+        }
+    }
+
+    // should never get here
+    return false;
+}
+
+bool HopfieldNetwork::computeSynchronously(unsigned long* const maxSteps, bool* const cycle, const unsigned int threadCount)
+{
+    ThreadPool pool(threadCount);
+    const unsigned long workerCount=pool.getThreadCount();
+
+    // every worker decides with its own random generator and owns a range of neurons and potentials
+    vector<RandomGenerator> randoms;
+    for (unsigned long t=0; t<workerCount; t++) randoms.push_back(m_random.split());
+    const vector<unsigned long> rangeStarts=splitNeurons(workerCount);
+
+    vector< vector<unsigned long> > flips(workerCount); // neurons flipped by every worker
+    NeuronState priorValues; // state before the last update, to detect cycles of two states
+
+    if (cycle) *cycle=false;
+    unsigned long currentSteps=0;
+
+    while (maxSteps==NULL || *maxSteps==0 || currentSteps<*maxSteps)
+    {
+        currentSteps+=m_neuronCount;
+
+        // the temperature stays the same within an update, cooling down follows for every neuron processed
+        const bool hot=m_temperatureModule&&m_temperatureModule->isHot();
+        const double inverseTemperature=hot ? m_temperatureModule->getInverseTemperature() : 0.0L;
+        const NeuronState previousValues=m_neuronValues;
+
+        // decide all neurons from the potentials of the previous state
+        for (unsigned long t=0; t<workerCount; t++)
+        {
+            pool.submit([this, t, hot, inverseTemperature, &randoms, &rangeStarts, &flips]
+            {
+                flips[t].clear();
+                for (unsigned long neuron=rangeStarts[t]; neuron<rangeStarts[t+1]; neuron++)
+                {
+                    const double potential=m_neuronPotentials[neuron];
+                    // if potential is zero, keep the value of the neuron
+                    if (!potential) continue;
+
+                    const bool value=hot ? sampleValue(potential, inverseTemperature, randoms[t]) : (potential>=0);
+                    if (value!=m_neuronValues[neuron])
+                    {
+                        m_neuronValues.flip(neuron);
+                        flips[t].push_back(neuron);
+                    }
+                }
+            });
+        }
+        pool.wait();
+
+        if (hot) for (unsigned long i=0; i<m_neuronCount; i++) m_temperatureModule->coolDown();
+
+        unsigned long flipCount=0;
+        for (unsigned long t=0; t<workerCount; t++) flipCount+=flips[t].size();
+        if (!flipCount)
+        {
+            // equilibrium attained
+            if (maxSteps!=NULL && *maxSteps==0) *maxSteps=currentSteps;
+            return true;
+        }
+
+        // CAN BE A SUBJECT OF OPTIMIZATION
+        // an update of potentials costs about as much per flipped neuron as recalculation per active one
+        const bool recalculate=flipCount>=m_neuronValues.count();
+        for (unsigned long t=0; t<workerCount; t++)
+        {
+            pool.submit([this, t, workerCount, recalculate, &rangeStarts, &flips]
+            {
+                const unsigned long first=rangeStarts[t], last=rangeStarts[t+1];
+                if (recalculate)
+                {
+                    m_neuronWeights->calculatePotentialRange(m_neuronValues, m_neuronPotentials, first, last);
+                    return;
+                }
+                for (unsigned long source=0; source<workerCount; source++)
+                {
+                    for (unsigned long i=0; i<flips[source].size(); i++)
+                    {
+                        const unsigned long neuron=flips[source][i];
+                        m_neuronWeights->updatePotentialRange(neuron, m_neuronValues[neuron] ? 1.0L : -1.0L,
+                                                              m_neuronPotentials, first, last);
+                    }
+                }
+            });
+        }
+        pool.wait();
+
+        // linked neurons have flipped at once, recalculating the energy costs no more than the update
+        refreshEnergy();
+
+        // returning to the state before the previous one repeats forever unless the temperature decides otherwise
+        if (!hot && priorValues==m_neuronValues)
+        {
+            if (cycle) *cycle=true;
+            if (maxSteps!=NULL && *maxSteps==0) *maxSteps=currentSteps;
+            return false;
+        }
+        priorValues=previousValues;
+    }
+
+    // maxSteps used up
+    return false;
+}
+
+AnytimeResult HopfieldNetwork::computeAnytime(const AnytimeOptions& options)
+{
+    using std::chrono::steady_clock;
+    using std::chrono::duration;
+
+    const steady_clock::time_point start=steady_clock::now();
+    steady_clock::time_point deadline=options.deadline;
+    if (options.timeBudget<duration<double>(deadline-start).count())
+    {
+        deadline=start+std::chrono::duration_cast<steady_clock::duration>(duration<double>(options.timeBudget));
+    }
+
+    AnytimeResult result;
+    result.equilibrium=false;
+    result.timedOut=false;
+    result.steps=0;
+    result.seconds=0.0L;
+    result.bestFound=false;
+    result.bestEnergy=HUGE_VAL;
+
+    // keeps the current state if it is valid and better than the best one
+    auto recordBest=[this, &options, &result, start]()
+    {
+        if (result.bestFound && m_energy>=result.bestEnergy) return;
+        if (options.validator && !options.validator(*this)) return;
+        result.bestFound=true;
+        result.bestEnergy=m_energy;
+        result.bestState=m_neuronValues;
+        if (options.progress)
+        {
+            options.progress(result.bestState, result.bestEnergy, duration<double>(steady_clock::now()-start).count());
+        }
+    };
+    recordBest();
+
+    // whether no neuron would flip at zero temperature
+    auto isStable=[this]()
+    {
+        for (unsigned long i=0; i<m_neuronCount; i++)
+        {
+            if (m_neuronValues[i] ? m_neuronPotentials[i]<0 : m_neuronPotentials[i]>0) return false;
+        }
+        return true;
+    };
+
+    vector<unsigned long int> permutation;
+    unsigned long position=m_neuronCount; // in the current sweep
+    unsigned long changed=0; // in the current sweep
+    while (m_neuronCount)
+    {
+        if (position==m_neuronCount)
+        {
+            if (result.steps)
+            {
+                recordBest();
+
+                // without a change the state is stable, unless neurons drawn at random may have missed some
+                const bool hot=m_temperatureModule && m_temperatureModule->isHot();
+                if (!changed && (options.order!=RANDOM_SWEEPS || hot || isStable()))
+                {
+                    result.equilibrium=true;
+                    break;
+                }
+            }
+            position=0;
+            changed=0;
+            if (options.order==PERMUTED_SWEEPS) permutation=createRandomPermutation(m_neuronCount, m_random);
+        }
+
+        // the sweep goes on up to the next reading of the clock, the last one is cut short by maxSteps
+        unsigned long count=m_neuronCount-position<ANYTIME_CHECK_STEPS ? m_neuronCount-position : ANYTIME_CHECK_STEPS;
+        if (options.maxSteps && options.maxSteps-result.steps<count) count=options.maxSteps-result.steps;
+        for (unsigned long k=position; k<position+count; k++)
+        {
+            if (options.order==PERMUTED_SWEEPS && k+ROW_PREFETCH_DISTANCE<m_neuronCount)
+            {
+                m_neuronWeights->prefetchRow(permutation[k+ROW_PREFETCH_DISTANCE]);
+            }
+            const unsigned long neuron=options.order==SEQUENTIAL_SWEEPS ? k :
+                                      options.order==RANDOM_SWEEPS ? m_random.nextBounded(m_neuronCount) :
+                                                                     permutation[k];
+            const bool priorValue=m_neuronValues[neuron];
+            processNeuron(neuron); // cannot be out of bounds
+            if (priorValue!=m_neuronValues[neuron]) changed++;
+        }
+        position+=count;
+        result.steps+=count;
+
+        if (options.maxSteps && result.steps>=options.maxSteps) break; // maxSteps used up
+        if (steady_clock::now()>=deadline)
+        {
+            result.timedOut=true;
+            break;
+        }
+    }
+
+    // the run ends in the best state, flipping back the neurons that differ costs less than recalculating all potentials
+    recordBest();
+    if (result.bestFound && result.bestState!=m_neuronValues)
+    {
+        for (unsigned long i=0; i<m_neuronCount; i++) if (result.bestState[i]!=m_neuronValues[i]) flipNeuron(i);
+        refreshEnergy();
+    }
+    result.seconds=duration<double>(steady_clock::now()-start).count();
+    return result;
+}
+
+void HopfieldNetwork::read(istream& in, const weightLayout layout)
 {
     in.exceptions(std::istream::failbit | std::istream::badbit);
 
@@ -406,32 +1141,81 @@ istream& operator>> (istream& in, HopfieldNetwork& network)
         vector<bool> tempNeuronValues;
         tempNeuronValues.reserve(tempNeuronCount);
         bool tempBool;
-        for (unsigned long i;i<tempNeuronCount;i++)
+        for (unsigned long i=0;i<tempNeuronCount;i++)
         {
             in>>tempBool;
             tempNeuronValues.push_back(tempBool);
         }
 
         // read neuronweights
-        vector< vector<double> > tempNeuronWeights(tempNeuronCount, vector<double>());
-        double tempDouble;
-        for (unsigned long i=0;i<tempNeuronCount;i++)
+        if (layout==SPARSE_WEIGHTS)
+        {
+            // keep only the nonzero weights of every row
+            SparseWeightStore* tempNeuronWeights=new SparseWeightStore();
+            shared_ptr<const WeightStore> tempStore(tempNeuronWeights);
+            vector<double> tempRow(tempNeuronCount);
+            for (unsigned long i=0;i<tempNeuronCount;i++)
+            {
+                for (unsigned long j=0; j<tempNeuronCount;j++) in>>tempRow[j];
+
+                tempNeuronWeights->appendNeuron(tempRow[i]);
+                for (unsigned long j=0; j<tempNeuronCount;j++)
+                {
+                    if (i!=j && tempRow[j]) tempNeuronWeights->appendLink(j, tempRow[j]);
+                }
+            }
+
+            // try to update the network with the data read
+            if (tempNeuronWeights->isSymmetric()) updateNetwork(tempStore, tempNeuronValues);
+            else raiseError(NON_SYMMETRIC);
+        }
+        else if (layout==PACKED_WEIGHTS)
         {
-            tempNeuronWeights[i].reserve(tempNeuronCount);
-            for (unsigned long j=0; j<tempNeuronCount;j++)
+            // keep only the upper triangle, the lower one is checked against it
+            PackedWeightStore* tempNeuronWeights=new PackedWeightStore(tempNeuronCount);
+            shared_ptr<const WeightStore> tempStore(tempNeuronWeights);
+            bool symmetric=true;
+            double tempDouble;
+            for (unsigned long i=0;i<tempNeuronCount;i++)
             {
-                in>>tempDouble;
-                tempNeuronWeights[i].push_back(tempDouble);
+                double* row=tempNeuronWeights->getRow(i);
+                for (unsigned long j=0; j<i;j++)
+                {
+                    in>>tempDouble;
+                    if (tempDouble!=tempNeuronWeights->getWeight(i, j)) symmetric=false;
+                }
+                for (unsigned long j=i; j<tempNeuronCount;j++) in>>row[j-i];
             }
+
+            // try to update the network with the data read
+            if (symmetric) updateNetwork(tempStore, tempNeuronValues);
+            else raiseError(NON_SYMMETRIC);
         }
+        else
+        {
+            // read straight into the rows of the weights matrix
+            DenseWeightStore* tempNeuronWeights=new DenseWeightStore(tempNeuronCount);
+            shared_ptr<const WeightStore> tempStore(tempNeuronWeights);
+            for (unsigned long i=0;i<tempNeuronCount;i++)
+            {
+                double* row=tempNeuronWeights->getRow(i);
+                for (unsigned long j=0; j<tempNeuronCount;j++) in>>row[j];
+            }
 
-        // try to update the network with the data read
-        network.updateNetwork(tempNeuronWeights, tempNeuronValues);
+            // try to update the network with the data read
+            if (tempNeuronWeights->isSymmetric()) updateNetwork(tempStore, tempNeuronValues);
+            else raiseError(NON_SYMMETRIC);
+        }
     }
     catch (std::istream::failure e)
     {
         raiseError(READ_FAILURE);
     }
+}
+
+istream& operator>> (istream& in, HopfieldNetwork& network)
+{
+    network.read(in, DENSE_WEIGHTS);
     return in;
 }
 
@@ -453,13 +1237,13 @@ ostream& operator<< (ostream& out, HopfieldNetwork& network)
 
 
 
-bool HopfieldNetwork::loadFromFile(const char* inFile)
+bool HopfieldNetwork::loadFromFile(const char* inFile, const weightLayout layout)
 {
     ifstream file(inFile);
     if (file.is_open())
     {
         // load the network
-        file>>(*this);
+        read(file, layout);
         return true;
     }
     else
@@ -473,57 +1257,91 @@ bool HopfieldNetwork::loadFromFile(const char* inFile)
     return false;
 }
 
+bool HopfieldNetwork::loadFromBinaryFile(const char* inFile, const bool verify)
+{
+    shared_ptr<const WeightStore> neuronWeights;
+    NeuronState neuronValues;
+    errorCode error=readNetworkFile(inFile, neuronWeights, neuronValues, verify);
+
+    if (error)
+    {
+        // if the file cannot be used, raise an error and do nothing
+        raiseError(error);
+        return false;
+    }
+
+    vector<bool> values(neuronValues.size());
+    for (unsigned long i=0; i<neuronValues.size(); i++) values[i]=neuronValues[i];
+    return updateNetwork(neuronWeights, values);
+}
+
+bool HopfieldNetwork::saveToBinaryFile(const char* outFile, const weightLayout layout) const
+{
+    if (!m_neuronWeights || !writeNetworkFile(outFile, *m_neuronWeights, m_neuronValues, layout))
+    {
+        raiseError(FILE_NOT_OPEN);
+        return false;
+    }
+    return true;
+}
+
+bool HopfieldNetwork::streamFromBinaryFile(const char* inFile, const unsigned long cacheRows)
+{
+    NeuronState neuronValues;
+    StreamedWeightStore* neuronWeights=StreamedWeightStore::open(inFile, cacheRows, &neuronValues);
+
+    if (!neuronWeights)
+    {
+        // if the file cannot be used, raise an error and do nothing
+        raiseError(FILE_FORMAT);
+        return false;
+    }
+
+    vector<bool> values(neuronValues.size());
+    for (unsigned long i=0; i<neuronValues.size(); i++) values[i]=neuronValues[i];
+    return updateNetwork(shared_ptr<const WeightStore>(neuronWeights), values);
+}
+
 void HopfieldNetwork::printWeights (ostream& out) const
 {
     for (unsigned long i=0; i < m_neuronCount;i++)
     {
         for (unsigned long j=0; j < m_neuronCount;j++)
         {
-            out<<m_neuronWeights[i][j]<<"\t";
+            out<<m_neuronWeights->getWeight(i, j)<<"\t";
         }
         out<<endl;
     }
     out<<endl;
 }
 
-void HopfieldNetwork::printPath (ostream& out) const
+vector<unsigned long> HopfieldNetwork::getPath() const
 {
+    vector<unsigned long> result;
     unsigned long sqr = (unsigned long)sqrt((double)m_neuronCount);
     for (unsigned long i=0; i < sqr; i++)
     {
         for (unsigned long j=0; j< sqr; j++)
         {
-            if (m_neuronValues[i + j* sqr] == 1) out<< j << "\t";
+            if (m_neuronValues[i + j* sqr] == 1) result.push_back(j);
         }
     }
+    return result;
+}
+
+void HopfieldNetwork::printPath (ostream& out) const
+{
+    const vector<unsigned long> path=getPath();
+    for (unsigned long i=0; i < path.size(); i++) out<< path[i] << "\t";
     out<<endl;
 }
 
 void HopfieldNetwork::printEnergy (ostream& out) const
 {
-    double E =0.0;
-    for (unsigned long i=0; i< m_neuronCount; i++)
-    {
-        for (unsigned long j=0; j<m_neuronCount; j++)
-        {
-            if (i!=j) E -=0.5 * m_neuronWeights[i][j]*m_neuronValues[i]*m_neuronValues[j];
-        }
-        E-= m_neuronWeights[i][i] * m_neuronValues[i];
-    }
-    out<<E<<endl;
-
+    out<<m_energy<<endl;
 }
 
 void HopfieldNetwork::printEnergy2(ostream& out) const
 {
-    double result=0.0L;
-
-    for (unsigned long i=0;i<m_neuronCount;i++)
-    {
-        for (unsigned long j=i;j<m_neuronCount;j++)
-        {
-            result-=m_neuronWeights[i][j]*m_neuronValues[i]*m_neuronValues[j];
-        }
-    }
-    out<<result<<endl;
+    out<<m_neuronWeights->calculateEnergy(m_neuronValues)<<endl;
 }
@@ -5,15 +5,21 @@
 #include <fstream>      /* ifstream */
 
 #include <vector>       /* vector */
-#include <algorithm>    /* random_shuffle */
+#include <memory>       /* shared_ptr */
+#include <algorithm>    /* swap, sort */
+#include <functional>   /* function */
+#include <chrono>       /* steady_clock */
 
-#include <stdlib.h>     /* srand, rand */
+#include <stdlib.h>     /* exit */
 #include <time.h>       /* time */
 
-#include <math.h>       /* log */
-#include <limits.h>     /* ULONG_MAX */
+#include <math.h>       /* log, HUGE_VAL */
+#include <limits.h>     /* ULONG_MAX, ULLONG_MAX */
 
 #include "temperaturemodule.h"
+#include "weightstore.h"
+#include "random.h"
+#include "acceptance.h"
 
 
 using std::cout;
@@ -25,6 +31,25 @@ using std::ostream;
 using std::ifstream;
 
 using std::vector;
+using std::shared_ptr;
+using std::function;
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// relative change of temperature after which computeRejectionFree recalculates all flip probabilities
+#define REJECTION_FREE_TOLERANCE 1e-2
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// number of sweeps worth of flips after which the tracked energy is recalculated from the potentials
+#define ENERGY_REFRESH_SWEEPS 1
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// how many neurons ahead of the one processed in a permutation the weight store is asked to prefetch
+#define ROW_PREFETCH_DISTANCE 8
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// most steps of computeAnytime between two readings of the clock, sweeps of larger networks are split
+#define ANYTIME_CHECK_STEPS 4096
+
 /**
   * Error codes of errors raised by raiseError
   */
@@ -37,6 +62,7 @@ enum errorCode
     UNKNOWN_MODE,
     READ_FAILURE,
     FILE_NOT_OPEN,
+    FILE_FORMAT,
     RANDOMIZATION,
     UNKNOWN_ERROR
 };
@@ -52,6 +78,7 @@ const static char* errorMessages[UNKNOWN_ERROR+1]={
     "Step by unknown mode requested. Ignoring.",
     "Exception when reading the network from the input. Ignoring.",
     "Unable to open the file. Ignoring.",
+    "The file is not in a valid format or it is corrupted. Ignoring.",
     "Could not set up a probability distribution. Exiting.",
     "Uknown error. Exiting."
 };
@@ -64,16 +91,32 @@ const static char* errorMessages[UNKNOWN_ERROR+1]={
 inline void raiseError(const errorCode error, ostream& out = cerr)
 {out<<errorMessages[error]<<endl;if (error==UNKNOWN_ERROR) exit(EXIT_FAILURE);}
 
+struct AnytimeOptions;
+struct AnytimeResult;
+
 class HopfieldNetwork
 {
 private:
 
-    vector< vector<double> > m_neuronWeights; // weights of links between neurons
-    vector<bool> m_neuronValues; // values of neurons
+    shared_ptr<const WeightStore> m_neuronWeights; // weights of links between neurons, shared by copies of the network
+    NeuronState m_neuronValues; // values of neurons
+    vector<double> m_neuronPotentials; // cached potentials of neurons, kept in sync with m_neuronValues
     unsigned long m_neuronCount;
 
+    double m_energy; // energy of m_neuronValues, updated by every flip
+    unsigned long m_flipsSinceRefresh; // flips added to m_energy since it was last recalculated
+
     TemperatureModule* m_temperatureModule;
 
+    RandomGenerator m_random; // source of randomness of the network
+
+    acceptanceMode m_acceptanceMode; // how values of neurons are decided at nonzero temperature
+    shared_ptr<const SigmoidTable> m_sigmoidTable; // used by TABULATED_ACCEPTANCE
+
+    // greedy colouring of the graph of links used by computeParallel, computed when first needed
+    vector<unsigned long> m_colourOrder; // neurons ordered by colour
+    vector<unsigned long> m_colourStarts; // start of every colour in m_colourOrder, followed by neuronCount
+
     /**
       * Checks whether a network with given neuronWeights, neuronValues and neuronCount will be inconsistent.
       * @param1 neuronWeights
@@ -83,22 +126,105 @@ private:
       */
     static errorCode isInconsistent(const vector< vector<double> >, const vector<bool>, const unsigned long);
 
+    /**
+      * Checks whether a network with given neuronWeights and neuronValues will be inconsistent.
+      * @param1 neuronWeights
+      * @param2 neuronValues
+      * @return inconsistency errorCode (0=NO_ERROR)
+      */
+    static errorCode isInconsistent(const shared_ptr<const WeightStore>&, const NeuronState&);
+
+    /**
+      * Recalculates the cached potentials of all neurons from scratch.
+      */
+    void resetPotentials();
+
+    /**
+      * Recalculates the tracked energy from the cached potentials of active neurons, discarding rounding errors
+      * accumulated by the flips.
+      */
+    void refreshEnergy();
+
+    /**
+      * Flips the value of a neuron and updates the cached potentials of all other neurons accordingly.
+      * @param1 position of the neuron
+      */
+    void flipNeuron(const unsigned long);
+
+    /**
+      * Colours the neurons greedily so that no two linked neurons share a colour, filling m_colourOrder and
+      * m_colourStarts.
+      */
+    void colourNeurons();
+
+    /**
+      * Splits the neurons into ranges aligned to words of the state, so that threads can write them independently.
+      * @param1 number of ranges
+      * @return starts of the ranges, followed by neuronCount
+      */
+    vector<unsigned long> splitNeurons(const unsigned long) const;
+
+    /**
+      * Decides the value of a neuron at nonzero temperature, TRUE with probability 1/(1+exp(-2*potential/temperature)).
+      * @param1 potential of the neuron
+      * @param2 inverse temperature
+      * @param3 random generator to use
+      * @return value of the neuron
+      */
+    inline bool sampleValue(const double potential, const double inverseTemperature, RandomGenerator& random) const
+    {
+        return isAccepted(2*potential*inverseTemperature, random.nextDouble(), m_acceptanceMode, m_sigmoidTable.get());
+    }
+
+    /**
+      * Loads the network from the given input.
+      * @param1 input
+      * @param2 layout in which the weights are to be stored
+      */
+    void read(istream&, const weightLayout);
+
 
 public:
 
     // TEMPORARY
     unsigned long getNeuronValueSum() const
     {
-        unsigned long result=0;
-        for (unsigned long i=0; i<m_neuronCount;i++)
-        {
-            if (m_neuronValues[i]) result++;
-        }
-        return result;
+        return m_neuronValues.count();
     }
 
     inline unsigned long getNeuronCount() const {return m_neuronCount;}
 
+    inline const NeuronState& getNeuronValues() const {return m_neuronValues;}
+
+    inline const shared_ptr<const WeightStore>& getWeightStore() const {return m_neuronWeights;}
+
+    /**
+      * Replaces the values of neurons, keeping the weights.
+      * @param1 neuronValues
+      * @return whether the values have been replaced (fails if the size does not match)
+      */
+    bool setNeuronValues(const NeuronState&);
+
+    /**
+      * Sets the value of a neuron, updating the cached potentials of the neurons linked to it rather than
+      * recalculating all of them.
+      * @param1 position of the neuron
+      * @param2 value
+      * @return whether the value has been set (fails if the neuron is out of bounds)
+      */
+    bool setNeuronValue(const unsigned long, const bool);
+
+    /**
+      * Changes the weights of links of given neurons in place and keeps the cached potentials and the energy in
+      * sync: the active ones among the neurons are taken out of the potentials of the others before the change
+      * and put back after it, and the potentials of the given neurons are recalculated. Links between other
+      * neurons must not change. The weights must not be shared with another network.
+      * @param1 neurons whose links change
+      * @param2 change of the weights
+      * @return whether the weights have been changed (fails if they are shared or a neuron is out of bounds)
+      */
+    bool updateWeights(const vector<unsigned long>&, const function<void (WeightStore&)>&);
+
     /**
       * Constructor of class HopfieldNetwork
       * @param1 neuronWeights (if left default, creates an empty network)
@@ -108,6 +234,13 @@ public:
     HopfieldNetwork(const vector< vector<double> > = vector< vector<double> >(),
                     const vector<bool> = vector<bool>(), const unsigned long = 0);
 
+    /**
+      * Constructor of class HopfieldNetwork
+      * @param1 neuronWeights given by a weight store
+      * @param2 neuronValues (if left default, all TRUE)
+      */
+    HopfieldNetwork(const shared_ptr<const WeightStore>&, const vector<bool>& = vector<bool>());
+
     /**
       * Updates the network if the input is consistent, otherwise raises and error and does nothing.
       * @param1 neuronWeights (if left default, creates an empty network)
@@ -118,11 +251,48 @@ public:
     bool updateNetwork(const vector< vector<double> > = vector< vector<double> >(),
                        const vector<bool> = vector<bool>(), const unsigned long = 0);
 
+    /**
+      * Updates the network if the input is consistent, otherwise raises and error and does nothing.
+      * Weights held in memory that qualify are replaced by a BitMaskWeightStore, weights mapped or streamed from
+      * a file are used as they are.
+      * @param1 neuronWeights given by a weight store
+      * @param2 neuronValues (if left default, all TRUE)
+      * @return whether the network has been updated
+      */
+    bool updateNetwork(const shared_ptr<const WeightStore>&, const vector<bool>& = vector<bool>());
+
     /**
       * Uploads a TemperatureModule for the network to use.
       */
     void uploadTemperatureModule(TemperatureModule* const module) {m_temperatureModule=module;}
 
+    inline TemperatureModule* getTemperatureModule() const {return m_temperatureModule;}
+
+    /**
+      * Seeds the random generator of the network, making its computation reproducible.
+      * @param1 seed
+      */
+    inline void setSeed(const uint64_t seed) {m_random.setSeed(seed);}
+
+    /**
+      * Returns the random generator of the network, e.g. to split off streams for other networks.
+      */
+    inline RandomGenerator& getRandomGenerator() {return m_random;}
+
+    /**
+      * Selects how the value of a neuron is decided at nonzero temperature (default EXACT_ACCEPTANCE).
+      * @param1 acceptance mode
+      * @param2 bound of the error of tabulated probabilities (default DEFAULT_SIGMOID_ERROR)
+      */
+    void setAcceptanceMode(const acceptanceMode, const double = DEFAULT_SIGMOID_ERROR);
+
+    inline acceptanceMode getAcceptanceMode() const {return m_acceptanceMode;}
+
+    /**
+      * Returns the table used by TABULATED_ACCEPTANCE, NULL if none has been created.
+      */
+    inline const shared_ptr<const SigmoidTable>& getSigmoidTable() const {return m_sigmoidTable;}
+
     /**
       * Sets temperature on the installed TemperatureModule. If none is installed, ignores.
       */
@@ -138,12 +308,32 @@ public:
     double calculatePotential(const unsigned long) const;
 
     /**
-      * Processes a neuron by calculating potential and changing its value accordingly.
+      * Returns the cached potential of a given neuron, including bias.
+      * @param1 position of the neuron
+      * @return potential
+      */
+    inline double getPotential(const unsigned long neuron) const {return m_neuronPotentials[neuron];}
+
+    /**
+      * Processes a neuron by reading its cached potential and changing its value accordingly.
       * @param1 position of the neuron
       * @return error code (NO_ERROR=0)
       */
     errorCode processNeuron(const unsigned long);
 
+    /**
+      * Processes every neuron once, in a random permutation.
+      * @return number of neurons whose value has changed
+      */
+    unsigned long processSweep();
+
+    /**
+      * Returns the energy of the network, -sum of weight[i][j] over active i<j - sum of biases of active neurons.
+      * It is tracked by the flips, so it costs nothing.
+      * @return energy
+      */
+    inline double energy() const {return m_energy;}
+
     /**
       * Computes the network sequentially until an equilibrium is achieved or the (optional) maximum number of steps is reached.
       * @param1 (pointer to) maximum number of steps - infinite if NULL(default) - stores the number of steps taken if 0
@@ -165,13 +355,97 @@ public:
       */
     bool computeRandomSeq(unsigned long* const= NULL);
 
+    /**
+      * Computes the network at zero temperature by flipping neurons drawn at random from the set of unstable ones,
+      * whose values disagree with their potentials, until the set is empty. Only the links of a flipped neuron are
+      * checked afterwards, so the cost is proportional to the number of flips. The temperature module is ignored.
+      * @param1 (pointer to) maximum number of flips - infinite if NULL(default) - stores the number of flips taken if 0
+      * @return whether an equilibrium has been achieved
+      */
+    bool computeUnstable(unsigned long* const = NULL);
+
+    /**
+      * Computes the network with the dynamics of computeRandomly, but without the rejected steps (the n-fold way):
+      * the flip probabilities of all neurons are kept in a tree, the next flip is drawn in proportion to them and
+      * the steps in which nothing would have flipped are skipped at once, cooling the temperature module down by
+      * the expected number of them processing a neuron with nonzero potential, the only ones processNeuron cools
+      * down on. Pays off at low temperatures, where most steps are rejected. The probabilities are refreshed when the
+      * temperature has changed by REJECTION_FREE_TOLERANCE. At zero temperature it flips unstable neurons.
+      * @param1 (pointer to) maximum number of steps, including the skipped ones - infinite if NULL(default) - stores
+      * the number of steps taken if 0
+      * @param2 temperature above which steps are taken one by one as in computeRandomly (if left default, never)
+      * @return whether an equilibrium has been achieved
+      */
+    bool computeRejectionFree(unsigned long* const = NULL, const double = HUGE_VAL);
+
+    /**
+      * Computes the network on many threads, colour by colour of a colouring of the graph of links: neurons of one
+      * colour are not linked, so they are decided at the same time without changing the dynamics. Pays off for
+      * sparse networks, where colours are few and large.
+      * @param1 (pointer to) maximum number of steps - infinite if NULL(default) - stores the number of steps taken if 0,
+      * checked between colours
+      * @param2 number of threads (if left default, the number of cores)
+      * @return whether an equilibrium has been achieved
+      */
+    bool computeParallel(unsigned long* const = NULL, const unsigned int = 0);
+
+    /**
+      * Computes the network synchronously: all neurons are updated at once from the previous state, after which the
+      * potentials are recalculated on many threads, as a product of the weights matrix with the state if many neurons
+      * have changed. Unlike the other modes, the network may end up alternating between two states.
+      * @param1 (pointer to) maximum number of steps - infinite if NULL(default) - stores the number of steps taken if 0,
+      * every update counting neuronCount steps
+      * @param2 (pointer to) where to store whether the network has ended in a cycle of two states (if NULL(default), ignored)
+      * @param3 number of threads (if left default, the number of cores)
+      * @return whether an equilibrium has been achieved
+      */
+    bool computeSynchronously(unsigned long* const = NULL, bool* const = NULL, const unsigned int = 0);
+
+    /**
+      * Computes the network in sweeps, in a given order, until a sweep changes nothing, a budget of steps or time
+      * is used up or a deadline passes. The clock is read after every sweep, or after every ANYTIME_CHECK_STEPS
+      * steps of large networks. After every sweep the state is compared with the best valid one seen so far by
+      * its (tracked) energy; a lower one is validated, kept and reported to the progress callback. At the end the
+      * network is left in the best valid state, which is returned, rather than in the last one.
+      * @param1 options of the run (see AnytimeOptions)
+      * @return outcome of the run and the best state
+      */
+    AnytimeResult computeAnytime(const AnytimeOptions&);
+
 
     /**
       * Loads the network from a given file.
       * @param1 path to the file
-      * @param2 whether the network has been succesfully loaded
+      * @param2 layout in which the weights are to be stored (default DENSE_WEIGHTS)
+      * @return whether the network has been succesfully loaded
+      */
+    bool loadFromFile(const char*, const weightLayout = DENSE_WEIGHTS);
+
+    /**
+      * Loads the network from a binary network file (see networkfile.h), mapping it into memory and using the
+      * weights in place.
+      * @param1 path to the file
+      * @param2 whether to check the checksum of the file and the symmetry of dense weights (default TRUE)
+      * @return whether the network has been succesfully loaded
+      */
+    bool loadFromBinaryFile(const char*, const bool = true);
+
+    /**
+      * Saves the network to a binary network file (see networkfile.h), to be loaded by loadFromBinaryFile.
+      * @param1 path to the file
+      * @param2 layout in which the weights are to be stored (default DENSE_WEIGHTS)
+      * @return whether the network has been succesfully saved
       */
-    bool loadFromFile(const char*);
+    bool saveToBinaryFile(const char*, const weightLayout = DENSE_WEIGHTS) const;
+
+    /**
+      * Loads the network from a binary network file with DENSE_WEIGHTS, leaving the weights in the file and reading
+      * rows of them as needed through a cache (see StreamedWeightStore), so that the weights need not fit in memory.
+      * @param1 path to the file
+      * @param2 number of rows of weights to keep in memory
+      * @return whether the network has been succesfully loaded
+      */
+    bool streamFromBinaryFile(const char*, const unsigned long);
 
     /**
       * Prints weigthts of the network to the given output.
@@ -179,10 +453,24 @@ public:
       */
     void printWeights (ostream& out = cout) const;
 
+    /**
+      * Decodes the path of a TSP network, listing the cities active at every step in order of steps.
+      * @return cities
+      */
+    vector<unsigned long> getPath() const;
+
     void printPath(ostream& out = cout) const;
 
+    /**
+      * Prints the (tracked) energy of the network to the given output.
+      * @param given output (default cout)
+      */
     void printEnergy(ostream& out = cout) const;
 
+    /**
+      * Prints the energy of the network recalculated from the weights to the given output, to check energy().
+      * @param given output (default cout)
+      */
     void printEnergy2(ostream& out = cout) const;
 
     /**
@@ -203,6 +491,54 @@ public:
 
 };
 
+/**
+  * A validator of states of networks, e.g. problems::isValidTour
+  */
+typedef bool (*stateValidator)(const HopfieldNetwork&);
+
+/**
+  * A callback reporting a new best state: the state, its energy and seconds since the start of the run
+  */
+typedef function<void(const NeuronState&, const double, const double)> progressCallback;
+
+/**
+  * Orders of neurons in sweeps of computeAnytime
+  */
+enum sweepOrder
+{
+    SEQUENTIAL_SWEEPS = 0, // neurons one after another, as in computeSequentially
+    RANDOM_SWEEPS, // neuronCount neurons drawn at random, as in computeRandomly
+    PERMUTED_SWEEPS // neurons in a new random permutation every sweep, as in computeRandomSeq
+};
 
+/**
+  * Bounds and reporting of a run of computeAnytime
+  */
+struct AnytimeOptions
+{
+    double timeBudget; // seconds from the start of the run, HUGE_VAL if none
+    std::chrono::steady_clock::time_point deadline; // time_point::max() if none
+    unsigned long maxSteps; // 0 if none
+    sweepOrder order;
+    stateValidator validator; // decides which states can be the best one, NULL accepts all
+    progressCallback progress; // called with every new best state, empty if none
+
+    AnytimeOptions():timeBudget(HUGE_VAL), deadline(std::chrono::steady_clock::time_point::max()), maxSteps(0),
+        order(PERMUTED_SWEEPS), validator(NULL), progress(){}
+};
+
+/**
+  * Outcome of a run of computeAnytime
+  */
+struct AnytimeResult
+{
+    bool equilibrium; // whether a sweep has changed nothing
+    bool timedOut; // whether the time budget or the deadline has ended the run
+    unsigned long steps; // steps taken
+    double seconds; // time taken
+    bool bestFound; // whether a valid state has been seen
+    double bestEnergy; // energy of the best valid state
+    NeuronState bestState; // best valid state, in which the network is left
+};
 
 #endif // NETWORK_H
@@ -0,0 +1,298 @@
+#include "networkfile.h"
+#include "mappedfile.h"
+
+#include <fstream>      /* ofstream */
+#include <vector>       /* vector */
+#include <algorithm>    /* sort */
+#include <utility>      /* pair */
+
+#include <string.h>     /* memcpy, memcmp, strncpy */
+
+using std::ofstream;
+using std::vector;
+using std::pair;
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// bytes gathered before they are written
+#define WRITE_BUFFER_SIZE (1<<20)
+
+// rounds a size of a section up to whole WEIGHTS_ALIGNMENT blocks
+inline uint64_t alignSection(const uint64_t bytes)
+{
+    return (bytes+WEIGHTS_ALIGNMENT-1)/WEIGHTS_ALIGNMENT*WEIGHTS_ALIGNMENT;
+}
+
+/**
+  * Sizes of the sections of a network file, following from the header.
+  */
+struct NetworkFileSections
+{
+    uint64_t valuesBytes;
+    uint64_t weightsBytes; // of all sections of weights
+    uint64_t linkStartsOffset, linkNeuronsOffset, linkWeightsOffset; // SPARSE_WEIGHTS only, relative to weightsOffset
+
+    NetworkFileSections(const uint64_t neuronCount, const uint64_t linkCount, const weightLayout layout):
+        valuesBytes((neuronCount+STATE_WORD_BITS-1)/STATE_WORD_BITS*sizeof(uint64_t)), weightsBytes(0),
+        linkStartsOffset(0), linkNeuronsOffset(0), linkWeightsOffset(0)
+    {
+        if (layout==DENSE_WEIGHTS)
+        {
+            weightsBytes=neuronCount*padWeights(neuronCount)*sizeof(double);
+        }
+        else if (layout==PACKED_WEIGHTS)
+        {
+            for (uint64_t i=0; i<neuronCount; i++) weightsBytes+=padWeights(neuronCount-i)*sizeof(double);
+        }
+        else
+        {
+            linkStartsOffset=alignSection(neuronCount*sizeof(double));
+            linkNeuronsOffset=linkStartsOffset+alignSection((neuronCount+1)*sizeof(uint64_t));
+            linkWeightsOffset=linkNeuronsOffset+alignSection(linkCount*sizeof(uint32_t));
+            weightsBytes=linkWeightsOffset+alignSection(linkCount*sizeof(double));
+        }
+    }
+};
+
+/**
+  * Writes the sections of a network file after its header, adding them to the checksum.
+  */
+class SectionWriter
+{
+private:
+    ofstream& m_out;
+    vector<char> m_buffer; // bytes not written yet
+    uint64_t m_written; // bytes written after the header
+    uint64_t m_checksum;
+
+    // writes the whole words of the buffer, the checksum is computed by words
+    void flush()
+    {
+        const uint64_t words=m_buffer.size()/sizeof(uint64_t);
+        vector<uint64_t> data(words);
+        if (words) memcpy(&data[0], &m_buffer[0], words*sizeof(uint64_t));
+        m_checksum=updateChecksum(m_checksum, data.empty() ? NULL : &data[0], words);
+        m_out.write(&m_buffer[0], words*sizeof(uint64_t));
+        m_buffer.erase(m_buffer.begin(), m_buffer.begin()+words*sizeof(uint64_t));
+        m_written+=words*sizeof(uint64_t);
+    }
+
+public:
+    SectionWriter(ofstream& out):m_out(out), m_buffer(), m_written(0), m_checksum(NETWORK_FILE_CHECKSUM_SEED){}
+
+    inline void write(const void* data, const uint64_t bytes)
+    {
+        m_buffer.insert(m_buffer.end(), static_cast<const char*>(data), static_cast<const char*>(data)+bytes);
+        if (m_buffer.size()>=WRITE_BUFFER_SIZE) flush();
+    }
+
+    /**
+      * Ends a section by padding it to a WEIGHTS_ALIGNMENT boundary.
+      */
+    inline void endSection()
+    {
+        m_buffer.resize(m_buffer.size()+alignSection(m_written+m_buffer.size())-(m_written+m_buffer.size()), 0);
+        flush();
+    }
+
+    inline uint64_t getChecksum() const {return m_checksum;}
+};
+
+bool checkNetworkFileHeader(const NetworkFileHeader& header, const uint64_t fileSize)
+{
+    if (memcmp(header.magic, NETWORK_FILE_MAGIC, sizeof(NETWORK_FILE_MAGIC))) return false;
+    if (header.version!=NETWORK_FILE_VERSION || header.byteOrder!=NETWORK_FILE_BYTE_ORDER) return false;
+    if (header.dataType!=FLOAT64_WEIGHTS || header.layout>SPARSE_WEIGHTS) return false;
+
+    const weightLayout layout=static_cast<weightLayout>(header.layout);
+    if (header.neuronCount>UINT32_MAX || (layout!=SPARSE_WEIGHTS && header.linkCount)) return false;
+
+    const NetworkFileSections sections(header.neuronCount, header.linkCount, layout);
+    if (header.valuesOffset!=NETWORK_FILE_HEADER_SIZE) return false;
+    if (header.weightsOffset!=header.valuesOffset+alignSection(sections.valuesBytes)) return false;
+    return header.fileSize==header.weightsOffset+sections.weightsBytes && header.fileSize==fileSize;
+}
+
+bool writeNetworkFile(const char* path, const WeightStore& weights, const NeuronState& neuronValues,
+                      const weightLayout layout)
+{
+    const unsigned long neuronCount=weights.getNeuronCount();
+    if (neuronValues.size()!=neuronCount) return false;
+
+    ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+
+    // links of every neuron, ordered by the other neuron, are needed for SPARSE_WEIGHTS
+    vector<unsigned long> linkNeurons;
+    vector<double> linkWeights;
+    uint64_t linkCount=0;
+    if (layout==SPARSE_WEIGHTS)
+    {
+        for (unsigned long i=0; i<neuronCount; i++)
+        {
+            weights.getLinks(i, linkNeurons, linkWeights);
+            linkCount+=linkNeurons.size();
+        }
+    }
+
+    NetworkFileHeader header;
+    memset(&header, 0, sizeof(header));
+    strncpy(header.magic, NETWORK_FILE_MAGIC, sizeof(header.magic));
+    header.version=NETWORK_FILE_VERSION;
+    header.byteOrder=NETWORK_FILE_BYTE_ORDER;
+    header.layout=layout;
+    header.dataType=FLOAT64_WEIGHTS;
+    header.neuronCount=neuronCount;
+    header.linkCount=linkCount;
+
+    const NetworkFileSections sections(neuronCount, linkCount, layout);
+    header.valuesOffset=NETWORK_FILE_HEADER_SIZE;
+    header.weightsOffset=header.valuesOffset+alignSection(sections.valuesBytes);
+    header.fileSize=header.weightsOffset+sections.weightsBytes;
+
+    // the header is written once the checksum is known
+    const vector<char> emptyHeader(NETWORK_FILE_HEADER_SIZE, 0);
+    file.write(&emptyHeader[0], NETWORK_FILE_HEADER_SIZE);
+
+    SectionWriter writer(file);
+    writer.write(neuronValues.getWords(), sections.valuesBytes);
+    writer.endSection();
+
+    if (layout==SPARSE_WEIGHTS)
+    {
+        for (unsigned long i=0; i<neuronCount; i++)
+        {
+            const double bias=weights.getWeight(i, i);
+            writer.write(&bias, sizeof(bias));
+        }
+        writer.endSection();
+
+        uint64_t linkStart=0;
+        for (unsigned long i=0; i<neuronCount; i++)
+        {
+            writer.write(&linkStart, sizeof(linkStart));
+            weights.getLinks(i, linkNeurons, linkWeights);
+            linkStart+=linkNeurons.size();
+        }
+        writer.write(&linkStart, sizeof(linkStart));
+        writer.endSection();
+
+        // other neurons, then weights of the links
+        vector< pair<unsigned long, double> > links;
+        for (unsigned int part=0; part<2; part++)
+        {
+            for (unsigned long i=0; i<neuronCount; i++)
+            {
+                weights.getLinks(i, linkNeurons, linkWeights);
+                links.clear();
+                for (unsigned long link=0; link<linkNeurons.size(); link++)
+                {
+                    links.push_back(pair<unsigned long, double>(linkNeurons[link], linkWeights[link]));
+                }
+                std::sort(links.begin(), links.end());
+
+                for (unsigned long link=0; link<links.size(); link++)
+                {
+                    const uint32_t other=links[link].first;
+                    if (part) writer.write(&links[link].second, sizeof(double));
+                    else writer.write(&other, sizeof(other));
+                }
+            }
+            writer.endSection();
+        }
+    }
+    else
+    {
+        // rows as laid out by the weight stores, padded with zeros
+        vector<double> row;
+        for (unsigned long i=0; i<neuronCount; i++)
+        {
+            const unsigned long first=layout==PACKED_WEIGHTS ? i : 0;
+            row.assign(padWeights(neuronCount-first), 0.0L);
+            for (unsigned long j=first; j<neuronCount; j++) row[j-first]=weights.getWeight(i, j);
+            writer.write(&row[0], row.size()*sizeof(double));
+        }
+        writer.endSection();
+    }
+
+    header.checksum=writer.getChecksum();
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return file.good();
+}
+
+errorCode readNetworkFile(const char* path, shared_ptr<const WeightStore>& neuronWeights, NeuronState& neuronValues,
+                          const bool verify)
+{
+    shared_ptr<MappedFile> file(new MappedFile());
+    if (!file->open(path)) return FILE_NOT_OPEN;
+
+    // check the header before anything is read by it
+    NetworkFileHeader header;
+    if (file->getSize()<NETWORK_FILE_HEADER_SIZE) return FILE_FORMAT;
+    memcpy(&header, file->getData(), sizeof(header));
+    if (!checkNetworkFileHeader(header, file->getSize())) return FILE_FORMAT;
+
+    const weightLayout layout=static_cast<weightLayout>(header.layout);
+    const unsigned long neuronCount=header.neuronCount;
+    const NetworkFileSections sections(neuronCount, header.linkCount, layout);
+
+    if (verify)
+    {
+        const uint64_t* words=reinterpret_cast<const uint64_t*>(file->getData()+NETWORK_FILE_HEADER_SIZE);
+        const uint64_t wordCount=(header.fileSize-NETWORK_FILE_HEADER_SIZE)/sizeof(uint64_t);
+        if (updateChecksum(NETWORK_FILE_CHECKSUM_SEED, words, wordCount)!=header.checksum) return FILE_FORMAT;
+    }
+
+    char* weights=file->getData()+header.weightsOffset;
+    const NeuronState values(reinterpret_cast<const uint64_t*>(file->getData()+header.valuesOffset), neuronCount);
+
+    if (layout==DENSE_WEIGHTS)
+    {
+        const DenseWeightStore* denseWeights=new DenseWeightStore(neuronCount, reinterpret_cast<double*>(weights), file);
+        shared_ptr<const WeightStore> store(denseWeights);
+
+        // both triangles are stored, which only writeNetworkFile keeps equal
+        if (verify && !denseWeights->isSymmetric()) return NON_SYMMETRIC;
+        neuronWeights=store;
+    }
+    else if (layout==PACKED_WEIGHTS)
+    {
+        neuronWeights=shared_ptr<const WeightStore>(new PackedWeightStore(neuronCount, reinterpret_cast<double*>(weights), file));
+    }
+    else
+    {
+        // compressed rows are held in vectors, they are copied but not parsed
+        const double* biases=reinterpret_cast<const double*>(weights);
+        const uint64_t* linkStarts=reinterpret_cast<const uint64_t*>(weights+sections.linkStartsOffset);
+        const uint32_t* linkNeurons=reinterpret_cast<const uint32_t*>(weights+sections.linkNeuronsOffset);
+        const double* linkWeights=reinterpret_cast<const double*>(weights+sections.linkWeightsOffset);
+
+        if (linkStarts[0] || linkStarts[neuronCount]!=header.linkCount) return FILE_FORMAT;
+        SparseWeightStore* sparseWeights=new SparseWeightStore();
+        shared_ptr<const WeightStore> store(sparseWeights);
+        for (unsigned long i=0; i<neuronCount; i++)
+        {
+            if (linkStarts[i+1]<linkStarts[i] || linkStarts[i+1]>header.linkCount) return FILE_FORMAT;
+            sparseWeights->appendNeuron(biases[i]);
+            for (uint64_t link=linkStarts[i]; link<linkStarts[i+1]; link++)
+            {
+                // links of a neuron are sorted and never lead to the neuron itself, getWeight relies on it
+                if (linkNeurons[link]>=neuronCount || linkNeurons[link]==i) return FILE_FORMAT;
+                if (link>linkStarts[i] && linkNeurons[link]<=linkNeurons[link-1]) return FILE_FORMAT;
+                sparseWeights->appendLink(linkNeurons[link], linkWeights[link]);
+            }
+        }
+        if (!sparseWeights->isSymmetric()) return NON_SYMMETRIC;
+        neuronWeights=store;
+    }
+
+    neuronValues=values;
+    return NO_ERROR;
+}
+
+bool convertNetworkFile(const char* textFile, const char* binaryFile, const weightLayout layout)
+{
+    HopfieldNetwork network;
+    if (!network.loadFromFile(textFile, layout) || !network.getNeuronCount()) return false;
+    return writeNetworkFile(binaryFile, *network.getWeightStore(), network.getNeuronValues(), layout);
+}
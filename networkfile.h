@@ -0,0 +1,115 @@
+#ifndef NETWORKFILE_H
+#define NETWORKFILE_H
+
+#include <stdint.h>     /* uint32_t, uint64_t */
+#include <memory>       /* shared_ptr */
+
+#include "network.h"
+
+using std::shared_ptr;
+
+/**
+  * Binary network files hold the values of neurons and the weights in the layout of a weight store, so that they
+  * are mapped into memory and the weights are used in place instead of being parsed.
+  *
+  * The file starts with a NetworkFileHeader, followed by sections each starting on a WEIGHTS_ALIGNMENT boundary:
+  *     values of neurons - the words of a NeuronState
+  *     DENSE_WEIGHTS - the rows of a DenseWeightStore, each padded by padWeights(neuronCount)
+  *     PACKED_WEIGHTS - the rows of a PackedWeightStore, row i padded by padWeights(neuronCount-i)
+  *     SPARSE_WEIGHTS - four sections: biases, starts of the links of every neuron followed by linkCount (uint64),
+  *                      other neurons of the links (uint32) and weights of the links, links of every neuron ordered
+  *                      by the other neuron
+  * All numbers are in the byte order of the machine that has written the file, which is checked by byteOrder.
+  */
+
+#define NETWORK_FILE_MAGIC "HOPFNET"
+#define NETWORK_FILE_VERSION 1
+#define NETWORK_FILE_BYTE_ORDER 0x01020304
+
+// header takes whole WEIGHTS_ALIGNMENT blocks
+#define NETWORK_FILE_HEADER_SIZE 128
+
+/**
+  * Types of weights in network files
+  */
+enum weightType
+{
+    FLOAT64_WEIGHTS = 0
+};
+
+/**
+  * Header of a binary network file
+  */
+struct NetworkFileHeader
+{
+    char magic[8]; // NETWORK_FILE_MAGIC
+    uint32_t version; // NETWORK_FILE_VERSION
+    uint32_t byteOrder; // NETWORK_FILE_BYTE_ORDER as written
+    uint32_t layout; // weightLayout
+    uint32_t dataType; // weightType
+    uint64_t neuronCount;
+    uint64_t linkCount; // SPARSE_WEIGHTS only
+    uint64_t valuesOffset; // position of the values of neurons
+    uint64_t weightsOffset; // position of the first section of weights
+    uint64_t fileSize;
+    uint64_t checksum; // of everything after the header, by updateChecksum
+};
+
+// initial value of the checksum
+#define NETWORK_FILE_CHECKSUM_SEED 0xcbf29ce484222325ULL
+
+/**
+  * Adds words to a checksum (64-bit FNV-1a over words).
+  * @param1 checksum so far (NETWORK_FILE_CHECKSUM_SEED at first)
+  * @param2 words
+  * @param3 number of words
+  * @return new checksum
+  */
+inline uint64_t updateChecksum(uint64_t checksum, const uint64_t* words, const uint64_t count)
+{
+    for (uint64_t i=0; i<count; i++) checksum=(checksum^words[i])*0x100000001b3ULL;
+    return checksum;
+}
+
+/**
+  * Checks whether a header is consistent with itself and with the size of its file, not reading the checksum.
+  * @param1 header
+  * @param2 size of the file
+  * @return whether the header describes a valid network file
+  */
+bool checkNetworkFileHeader(const NetworkFileHeader&, const uint64_t);
+
+/**
+  * Writes weights and values of neurons to a binary network file.
+  * @param1 path of the file
+  * @param2 weights, in any store
+  * @param3 values of neurons
+  * @param4 layout of the weights in the file
+  * @return whether the file has been written
+  */
+bool writeNetworkFile(const char*, const WeightStore&, const NeuronState&, const weightLayout);
+
+/**
+  * Maps a binary network file and creates a weight store using the weights in place, except for SPARSE_WEIGHTS,
+  * which are copied into a SparseWeightStore. Sparse links are checked to be sorted, not to lead to their own
+  * neuron and to be symmetric while they are copied. PACKED_WEIGHTS hold one triangle and are symmetric by their
+  * layout. DENSE_WEIGHTS hold both triangles and are checked to be symmetric only when verifying, otherwise the
+  * file is trusted to have been written by writeNetworkFile.
+  * @param1 path of the file
+  * @param2 weights (output)
+  * @param3 values of neurons (output)
+  * @param4 whether to check the checksum, which reads the whole file once, and the symmetry of dense weights
+  * @return NO_ERROR, FILE_NOT_OPEN, FILE_FORMAT or NON_SYMMETRIC
+  */
+errorCode readNetworkFile(const char*, shared_ptr<const WeightStore>&, NeuronState&, const bool);
+
+/**
+  * Converts a network from the text format read by HopfieldNetwork::loadFromFile to a binary network file.
+  * @param1 path of the text file
+  * @param2 path of the binary file
+  * @param3 layout of the weights in the binary file (default DENSE_WEIGHTS)
+  * @return whether the network has been converted
+  */
+bool convertNetworkFile(const char*, const char*, const weightLayout = DENSE_WEIGHTS);
+
+#endif // NETWORKFILE_H
@@ -0,0 +1,106 @@
+#ifndef NEURONSTATE_H
+#define NEURONSTATE_H
+
+#include <vector>       /* vector */
+#include <stdint.h>     /* uint64_t */
+#include <stddef.h>     /* NULL */
+
+using std::vector;
+
+// number of neuron values packed in one word
+#define STATE_WORD_BITS 64
+
+/**
+  * Values of neurons of a network, packed into 64-bit words. Bits past the last neuron are always zero.
+  */
+class NeuronState
+{
+private:
+    vector<uint64_t> m_words; // values of neurons, neuron i is bit i%64 of word i/64
+    unsigned long m_size; // number of neurons
+
+    inline static unsigned long wordCount(const unsigned long size) {return (size+STATE_WORD_BITS-1)/STATE_WORD_BITS;}
+    inline static uint64_t bit(const unsigned long position) {return uint64_t(1)<<(position%STATE_WORD_BITS);}
+
+public:
+    /**
+      * Constructor of class NeuronState
+      * @param1 number of neurons
+      * @param2 value of all neurons (default FALSE)
+      */
+    NeuronState(const unsigned long size = 0, const bool value = false):
+        m_words(wordCount(size), value ? ~uint64_t(0) : 0), m_size(size)
+    {
+        // keep the bits past the last neuron zero
+        if (value && size%STATE_WORD_BITS) m_words.back()=bit(size)-1;
+    }
+
+    /**
+      * Constructor of class NeuronState
+      * @param1 values of neurons
+      */
+    NeuronState(const vector<bool>& values):m_words(wordCount(values.size()), 0), m_size(values.size())
+    {
+        for (unsigned long i=0; i<m_size; i++) if (values[i]) set(i, true);
+    }
+
+    /**
+      * Constructor of class NeuronState
+      * @param1 words holding the values as returned by getWords, bits past the last neuron are ignored
+      * @param2 number of neurons
+      */
+    NeuronState(const uint64_t* words, const unsigned long size):m_words(words, words+wordCount(size)), m_size(size)
+    {
+        if (size%STATE_WORD_BITS) m_words.back()&=bit(size)-1;
+    }
+
+    inline unsigned long size() const {return m_size;}
+
+    inline bool operator[] (const unsigned long position) const
+    {return m_words[position/STATE_WORD_BITS]&bit(position);}
+
+    inline void set(const unsigned long position, const bool value)
+    {if (value) m_words[position/STATE_WORD_BITS]|=bit(position); else m_words[position/STATE_WORD_BITS]&=~bit(position);}
+
+    inline void flip(const unsigned long position) {m_words[position/STATE_WORD_BITS]^=bit(position);}
+
+    /**
+      * Finds the first active neuron at a given position or after it.
+      * @param1 position
+      * @return position of the active neuron, size() if there is none
+      */
+    inline unsigned long findActive(const unsigned long position) const
+    {
+        if (position>=m_size) return m_size;
+        unsigned long word=position/STATE_WORD_BITS;
+        uint64_t bits=m_words[word]&(~uint64_t(0)<<(position%STATE_WORD_BITS));
+        while (!bits)
+        {
+            if (++word==m_words.size()) return m_size;
+            bits=m_words[word];
+        }
+        return word*STATE_WORD_BITS+__builtin_ctzll(bits);
+    }
+
+    /**
+      * Returns the words holding the values, to be used by kernels.
+      */
+    inline const uint64_t* getWords() const {return m_words.empty() ? NULL : &m_words[0];}
+    inline unsigned long getWordCount() const {return m_words.size();}
+
+    /**
+      * Counts the active neurons.
+      * @return number of neurons whose value is TRUE
+      */
+    inline unsigned long count() const
+    {
+        unsigned long result=0;
+        for (unsigned long i=0; i<m_words.size(); i++) result+=__builtin_popcountll(m_words[i]);
+        return result;
+    }
+
+    inline bool operator== (const NeuronState& other) const {return m_size==other.m_size && m_words==other.m_words;}
+    inline bool operator!= (const NeuronState& other) const {return !(*this==other);}
+};
+
+#endif // NEURONSTATE_H
@@ -1,37 +1,41 @@
 #include "problems.h"
+#include "tsplib.h"
+#include "kernels.h"
+#include "threadpool.h"
 #include <string>
 #include <fstream>
 #include <iostream>
 #include <math.h>
 
+// radius of the Earth and pi as given by TSPLIB for GEO_DISTANCE
+#define GEO_EARTH_RADIUS 6378.388
+#define GEO_PI 3.141592
+
 using namespace std;
 
 HopfieldNetwork problems::createRookProblem(const unsigned int boardSize)
 {
     const unsigned int neuronCount=boardSize*boardSize;
     const vector<bool> neuronValues=vector<bool>(neuronCount, false); // for clarity, could just use default value in constructor
-    vector< vector<double> > neuronWeights=
-            vector< vector<double> >(neuronCount, vector<double>(neuronCount,0));
+    SparseWeightStore* neuronWeights=new SparseWeightStore();
+    const shared_ptr<const WeightStore> weightStore(neuronWeights);
 
     for (unsigned int i=0; i<neuronCount; i++)
     {
+        neuronWeights->appendNeuron(1.0L);
         for (unsigned int j=0; j<neuronCount; j++)
         {
-            if (i==j)
-            {
-                neuronWeights[i][j]=1.0L;
-            }
-            else
+            if (i!=j)
             {
                 // If i, j are neurons in the same row or column
                 if ( (i%boardSize==j%boardSize) || (i/boardSize == j/boardSize) )
                 {
-                    neuronWeights[i][j]=-2.0L;
+                    neuronWeights->appendLink(j, -2.0L);
                 }
             }
         }
     }
-    return HopfieldNetwork(neuronWeights, neuronValues, neuronCount);
+    return HopfieldNetwork(weightStore, neuronValues);
 }
 
 /**
@@ -54,8 +58,8 @@ HopfieldNetwork problems::createQueenProblem(const unsigned int boardSize)
 {
     const unsigned int neuronCount=boardSize*boardSize;
     const vector<bool> neuronValues=vector<bool>(neuronCount, true); // for clarity, could just use default value in constructor
-    vector< vector<double> > neuronWeights=
-            vector< vector<double> >(neuronCount, vector<double>(neuronCount,0));
+    SparseWeightStore* neuronWeights=new SparseWeightStore();
+    const shared_ptr<const WeightStore> weightStore(neuronWeights);
 
     unsigned int iRow=0;
     unsigned int iColumn=0;
@@ -63,18 +67,22 @@ HopfieldNetwork problems::createQueenProblem(const unsigned int boardSize)
     {
         unsigned int jRow=0;
         unsigned int jColumn=0;
+        neuronWeights->appendNeuron(1L);
         for (unsigned int j=0; j<neuronCount; j++)
         {
-            if (i==j) neuronWeights[i][j]=1L;
+            if (i==j)
+            {
+                // the bias has been set by appendNeuron
+            }
             else if (iRow==jRow || iColumn==jColumn)
             {
                 // if i, j are neurons in the same row or column
-                neuronWeights[i][j]=-2L;
+                neuronWeights->appendLink(j, -2L);
             }
             else if (iRow-jRow==iColumn-jColumn || iRow-jRow==jColumn-iColumn)
             {
                 // if i, j  are neurons on the same diagonal
-                neuronWeights[i][j]=-2L;
+                neuronWeights->appendLink(j, -2L);
             }
 
             // proceed to the next j
@@ -85,68 +93,190 @@ HopfieldNetwork problems::createQueenProblem(const unsigned int boardSize)
         next (iRow, iColumn, boardSize);
 
     }
-    return HopfieldNetwork(neuronWeights, neuronValues, neuronCount);
+    return HopfieldNetwork(weightStore, neuronValues);
 }
 
-HopfieldNetwork problems::createTSP(std::string fileName, double delta){
+/**
+  * Converts a TSPLIB coordinate in degrees.minutes to radians, the degrees being truncated as by the reference
+  * implementations.
+  */
+inline double geoRadians(const double coordinate)
+{
+    const double degrees=(double)(long)coordinate;
+    return GEO_PI*(degrees+5.0L*(coordinate-degrees)/3.0L)/180.0L;
+}
 
-    std::ifstream inFile(fileName.c_str());
-    if (inFile.is_open()) {
-        unsigned int cityCount;
-        inFile >> cityCount;
-        unsigned int neuronCount = cityCount * cityCount;
-        const vector<bool> neuronValues=vector<bool>(neuronCount, false); // for clarity, could just use default value in constructor
-        vector< vector<double> > neuronWeights=
-                vector< vector<double> >(neuronCount, vector<double>(neuronCount,0));
-        //coordinates
-        vector< vector<int> > coordinates = vector< vector<int> >(cityCount, vector<int>(2,0));
-
-
-        for (unsigned int i=0; i < cityCount; i++){
-            int xCoordinate;
-            inFile >> xCoordinate;
-            int yCoordinate;
-            inFile >> yCoordinate;
-            coordinates[i][0] = xCoordinate;
-            coordinates[i][1] = yCoordinate;
+/**
+  * Computes the distances of a city to all cities of an instance.
+  * @param1 cities
+  * @param2 city
+  * @param3 distances (output)
+  * @param4 latitudes of all cities in radians, for GEO_DISTANCE only
+  * @param5 longitudes of all cities in radians, for GEO_DISTANCE only
+  */
+static void computeDistanceRow(const problems::TSPInstance& instance, const unsigned long city, float* distances,
+                               const vector<double>& latitudes, const vector<double>& longitudes)
+{
+    const unsigned long cityCount=instance.cityCount;
+    const double x=instance.xCoordinates[city], y=instance.yCoordinates[city];
+    switch (instance.function)
+    {
+    case problems::GEO_DISTANCE:
+        for (unsigned long j=0; j<cityCount; j++)
+        {
+            const double q1=cos(longitudes[city]-longitudes[j]);
+            const double q2=cos(latitudes[city]-latitudes[j]);
+            const double q3=cos(latitudes[city]+latitudes[j]);
+            distances[j]=city==j ? 0.0f
+                                 : (float)(long)(GEO_EARTH_RADIUS*acos(0.5L*((1.0L+q1)*q2-(1.0L-q1)*q3))+1.0L);
         }
+        break;
+    case problems::ATT_DISTANCE:
+        kernels::distanceRow(distances, x, y, &instance.xCoordinates[0], &instance.yCoordinates[0], cityCount, 10.0L,
+                             kernels::CEILING_ROUNDING);
+        break;
+    default:
+        kernels::distanceRow(distances, x, y, &instance.xCoordinates[0], &instance.yCoordinates[0], cityCount, 1.0L,
+                             instance.function==problems::EUC_2D_DISTANCE ? kernels::NEAREST_ROUNDING :
+                             instance.function==problems::CEIL_2D_DISTANCE ? kernels::CEILING_ROUNDING :
+                                                                            kernels::NO_ROUNDING);
+    }
+}
 
-        //compute distances
-        vector< vector<double> > distances = vector< vector<double> >(cityCount, vector<double>(cityCount, 0.0));
-        for (unsigned int i=0; i<cityCount; i++){
-            for (unsigned int j=0; j<cityCount; j++){
-                distances[i][j] = sqrt(pow(coordinates[i][0]-coordinates[j][0], 2.0)
-                        + pow(coordinates[i][1]-coordinates[j][1], 2.0));
-            }
-        }
+/**
+  * Converts the coordinates of cities to radians for GEO_DISTANCE, leaving the outputs empty for other functions.
+  */
+static void computeGeoRadians(const problems::TSPInstance& instance, vector<double>& latitudes,
+                              vector<double>& longitudes)
+{
+    if (instance.function!=problems::GEO_DISTANCE) return;
+    latitudes.resize(instance.cityCount);
+    longitudes.resize(instance.cityCount);
+    for (unsigned long i=0; i<instance.cityCount; i++)
+    {
+        latitudes[i]=geoRadians(instance.xCoordinates[i]);
+        longitudes[i]=geoRadians(instance.yCoordinates[i]);
+    }
+}
 
-        //compute weights
-        for (unsigned int cityIndex=0; cityIndex<cityCount; cityIndex++){
-            for (unsigned int step=0; step<cityCount; step++){
-                for (unsigned int nextCityIndex=0; nextCityIndex<cityCount; nextCityIndex++){
-                    if (cityIndex == nextCityIndex){
-                        for (unsigned int stepToSelf = 0; stepToSelf<cityCount; stepToSelf++){
-                            if (step == stepToSelf) neuronWeights[cityIndex*cityCount + step][cityIndex*cityCount + step] =
-                                    delta / 2.0;
-                            else neuronWeights[cityIndex*cityCount + step][cityIndex*cityCount + stepToSelf] =
-                                    -delta;
-                        }
-                    }
-                    else{
-                        neuronWeights[cityIndex*cityCount + step][nextCityIndex*cityCount + step] =
-                                -delta;
-                        neuronWeights[cityIndex*cityCount + step][nextCityIndex*cityCount + ((step+1)%cityCount)] =
-                                neuronWeights[nextCityIndex*cityCount + ((step+1)%cityCount)][cityIndex*cityCount + step] =
-                                - distances[cityIndex][nextCityIndex];
-                    }
-                }
+void problems::TSPInstance::computeDistances(const distanceFunction inFunction, const unsigned int threadCount)
+{
+    function=inFunction;
+    distances.resize(cityCount*cityCount);
+    if (!cityCount) return;
+
+    vector<double> latitudes, longitudes;
+    computeGeoRadians(*this, latitudes, longitudes);
+
+    // every thread takes a range of rows
+    ThreadPool pool(threadCount);
+    const unsigned long workerCount=pool.getThreadCount();
+    for (unsigned long t=0; t<workerCount; t++)
+    {
+        const unsigned long first=t*cityCount/workerCount, last=(t+1)*cityCount/workerCount;
+        pool.submit([this, first, last, &latitudes, &longitudes]
+        {
+            for (unsigned long i=first; i<last; i++)
+            {
+                computeDistanceRow(*this, i, &distances[i*cityCount], latitudes, longitudes);
             }
-        }
+        });
+    }
+    pool.wait();
+}
+
+void problems::TSPInstance::updateDistances(const vector<unsigned long>& cities)
+{
+    vector<double> latitudes, longitudes;
+    computeGeoRadians(*this, latitudes, longitudes);
+
+    // all distance functions are symmetric, the row of a city gives its column
+    for (unsigned long c=0; c<cities.size(); c++)
+    {
+        const unsigned long city=cities[c];
+        float* row=&distances[city*cityCount];
+        computeDistanceRow(*this, city, row, latitudes, longitudes);
+        for (unsigned long j=0; j<cityCount; j++) distances[j*cityCount+city]=row[j];
+    }
+}
+
+problems::TSPInstance problems::loadTSP(const std::string fileName)
+{
+    if (fileName.size()>4 && fileName.compare(fileName.size()-4, 4, ".tsp")==0) return loadTSPLIB(fileName);
+
+    TSPInstance result;
+    std::ifstream inFile(fileName.c_str());
+    if (!inFile.is_open())
+    {
+        raiseError(FILE_NOT_OPEN);
+        return result;
+    }
+
+    unsigned long cityCount=0;
+    inFile >> cityCount;
+
+    //coordinates
+    vector<double> xCoordinates(cityCount), yCoordinates(cityCount);
+    for (unsigned long i=0; i < cityCount; i++) inFile >> xCoordinates[i] >> yCoordinates[i];
+    if (!inFile)
+    {
+        raiseError(FILE_FORMAT);
+        return result;
+    }
+
+    //compute distances
+    result.cityCount=cityCount;
+    result.xCoordinates.swap(xCoordinates);
+    result.yCoordinates.swap(yCoordinates);
+    result.computeDistances();
+    return result;
+}
+
+HopfieldNetwork problems::createTSP(const TSPInstance& instance, const double delta)
+{
+    if (!instance.cityCount) return HopfieldNetwork();
 
-        inFile.close();
-        return HopfieldNetwork(neuronWeights, neuronValues, neuronCount);
+    const vector<bool> neuronValues=vector<bool>(instance.cityCount*instance.cityCount, false);
+
+    //weights are computed from the distances on the fly
+    return HopfieldNetwork(shared_ptr<const WeightStore>(new TSPWeightStore(instance.cityCount, instance.distances, delta)),
+                           neuronValues);
+}
+
+HopfieldNetwork problems::createTSP(const TSPInstance& instance, const double delta, const vector<unsigned long>& tour)
+{
+    if (!instance.cityCount) return HopfieldNetwork();
+
+    vector<bool> neuronValues=vector<bool>(instance.cityCount*instance.cityCount, false);
+    for (unsigned long step=0; step<tour.size() && step<instance.cityCount; step++)
+    {
+        if (tour[step]<instance.cityCount) neuronValues[tour[step]*instance.cityCount+step]=true;
     }
 
-    return HopfieldNetwork();
+    return HopfieldNetwork(shared_ptr<const WeightStore>(new TSPWeightStore(instance.cityCount, instance.distances, delta)),
+                           neuronValues);
 }
 
+HopfieldNetwork problems::createTSP(std::string fileName, double delta){
+
+    return createTSP(loadTSP(fileName), delta);
+}
+
+bool problems::isValidTour(const HopfieldNetwork& network)
+{
+    const NeuronState& neuronValues=network.getNeuronValues();
+    const unsigned long cityCount=(unsigned long)sqrt((double)network.getNeuronCount());
+    if (cityCount*cityCount!=network.getNeuronCount() || neuronValues.count()!=cityCount) return false;
+
+    // with exactly cityCount active neurons, it suffices that no step is taken twice and no city is visited twice
+    vector<bool> visitedCities(cityCount, false);
+    vector<bool> takenSteps(cityCount, false);
+    for (unsigned long i=neuronValues.findActive(0); i<cityCount*cityCount; i=neuronValues.findActive(i+1))
+    {
+        const unsigned long city=i/cityCount;
+        const unsigned long step=i%cityCount;
+        if (visitedCities[city] || takenSteps[step]) return false;
+        visitedCities[city]=takenSteps[step]=true;
+    }
+    return true;
+}
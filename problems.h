@@ -1,6 +1,8 @@
 #ifndef PROBLEMS_H
 #define PROBLEMS_H
 
+#include <string>       /* string */
+
 #include "network.h"
 
 /**
@@ -9,6 +11,51 @@
 namespace problems
 {
 
+/**
+  * Functions giving the distance of two cities from their coordinates, following TSPLIB
+  */
+enum distanceFunction
+{
+    EUCLIDEAN_DISTANCE = 0, // not rounded
+    EUC_2D_DISTANCE, // euclidean, rounded to the nearest integer
+    CEIL_2D_DISTANCE, // euclidean, rounded up
+    ATT_DISTANCE, // pseudo-euclidean, sqrt((dx*dx+dy*dy)/10) rounded up
+    GEO_DISTANCE // on the Earth, coordinates being latitudes and longitudes in degrees.minutes
+};
+
+/**
+  * Cities of a travelling salesman problem
+  */
+struct TSPInstance
+{
+    unsigned long cityCount;
+    vector<double> xCoordinates; // coordinates of cities, empty if only distances are known
+    vector<double> yCoordinates;
+    vector<float> distances; // distances of cities, row by row
+    distanceFunction function; // of the coordinates giving the distances
+
+    TSPInstance():cityCount(0), xCoordinates(), yCoordinates(), distances(), function(EUCLIDEAN_DISTANCE){}
+
+    /**
+      * Computes the distances of all cities from their coordinates.
+      * @param1 distance function (default EUCLIDEAN_DISTANCE)
+      * @param2 number of threads (if left default, the number of cores)
+      */
+    void computeDistances(const distanceFunction = EUCLIDEAN_DISTANCE, const unsigned int = 0);
+
+    /**
+      * Recomputes the distances of given cities to all others from their coordinates, e.g. after they have moved,
+      * by the distance function of the last computeDistances.
+      * @param1 cities
+      */
+    void updateDistances(const vector<unsigned long>&);
+
+    inline double getDistance(const unsigned long from, const unsigned long to) const
+    {return distances[from*cityCount+to];}
+
+    inline bool hasCoordinates() const {return !xCoordinates.empty();}
+};
+
 /**
   * Creates a Hopfield network for the 'Rook problem' of a given board size.
   * @param1 board_size
@@ -25,8 +72,42 @@ HopfieldNetwork createRookProblem(const unsigned int);
   */
 HopfieldNetwork createQueenProblem(const unsigned int);
 
+/**
+  * Loads the cities of a travelling salesman problem from a file holding the number of cities followed by
+  * their coordinates, computing euclidean distances. Files ending in .tsp are read as TSPLIB files by loadTSPLIB.
+  * @param1 name of the file
+  * @return cities, none if the file cannot be read
+  */
+TSPInstance loadTSP(const std::string);
+
+/**
+  * Creates a Hopfield network for the travelling salesman problem with given cities.
+  * Neuron city*cityCount+step is active iff the city is visited in the given step.
+  * @param1 cities
+  * @param2 penalty for visiting a city twice or two cities at once
+  * @return network for the travelling salesman problem
+  */
+HopfieldNetwork createTSP(const TSPInstance&, const double);
+
+/**
+  * Creates a Hopfield network for the travelling salesman problem with given cities in the state of a tour, e.g.
+  * to resume from a previous solution.
+  * @param1 cities
+  * @param2 penalty for visiting a city twice or two cities at once
+  * @param3 tour, city tour[step] is active in the given step (cities not in it are inactive)
+  * @return network for the travelling salesman problem
+  */
+HopfieldNetwork createTSP(const TSPInstance&, const double, const vector<unsigned long>&);
+
 HopfieldNetwork createTSP(std::string fileName, double delta);
 
+/**
+  * Checks whether the state of a TSP network is a tour, i.e. every city is visited at exactly one step.
+  * @param1 network created by createTSP
+  * @return whether the active neurons form a permutation matrix
+  */
+bool isValidTour(const HopfieldNetwork&);
+
 }
 
 
@@ -0,0 +1,54 @@
+#include "random.h"
+
+void RandomGenerator::setSeed(const uint64_t seed)
+{
+    // expand the seed by splitmix64, which never gives an all zero state
+    uint64_t value=seed;
+    for (unsigned int i=0; i<4; i++)
+    {
+        uint64_t mixed=(value+=0x9e3779b97f4a7c15ULL);
+        mixed=(mixed^(mixed>>30))*0xbf58476d1ce4e5b9ULL;
+        mixed=(mixed^(mixed>>27))*0x94d049bb133111ebULL;
+        m_state[i]=mixed^(mixed>>31);
+    }
+}
+
+void RandomGenerator::jump(const uint64_t* polynomial)
+{
+    uint64_t result[4]={0, 0, 0, 0};
+
+    for (unsigned int i=0; i<4; i++)
+    {
+        for (unsigned int bit=0; bit<64; bit++)
+        {
+            if (polynomial[i]&(uint64_t(1)<<bit))
+            {
+                for (unsigned int j=0; j<4; j++) result[j]^=m_state[j];
+            }
+            next();
+        }
+    }
+
+    for (unsigned int j=0; j<4; j++) m_state[j]=result[j];
+}
+
+void RandomGenerator::jump()
+{
+    static const uint64_t polynomial[4]=
+    {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL};
+    jump(polynomial);
+}
+
+void RandomGenerator::longJump()
+{
+    static const uint64_t polynomial[4]=
+    {0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL};
+    jump(polynomial);
+}
+
+RandomGenerator RandomGenerator::split()
+{
+    RandomGenerator result(*this);
+    jump();
+    return result;
+}
@@ -0,0 +1,99 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>     /* uint64_t */
+
+/**
+  * A fast pseudorandom number generator (xoshiro256++) with a period of 2^256-1.
+  * Every network owns one, so that networks can run on many threads and be reproduced from their seeds.
+  * Independent streams for parallel use are obtained by split, which jumps 2^128 numbers ahead.
+  */
+class RandomGenerator
+{
+private:
+    uint64_t m_state[4];
+
+    inline static uint64_t rotateLeft(const uint64_t value, const int bits) {return (value<<bits)|(value>>(64-bits));}
+
+    /**
+      * Advances the state by a given polynomial, used by jump and longJump.
+      * @param1 coefficients of the jump polynomial
+      */
+    void jump(const uint64_t*);
+
+public:
+    /**
+      * Constructor of class RandomGenerator
+      * @param1 seed
+      */
+    RandomGenerator(const uint64_t seed = 0) {setSeed(seed);}
+
+    /**
+      * Restarts the generator from a given seed.
+      * @param1 seed
+      */
+    void setSeed(const uint64_t);
+
+    /**
+      * Returns the next 64 random bits.
+      */
+    inline uint64_t next()
+    {
+        const uint64_t result=rotateLeft(m_state[0]+m_state[3], 23)+m_state[0];
+        const uint64_t shifted=m_state[1]<<17;
+
+        m_state[2]^=m_state[0];
+        m_state[3]^=m_state[1];
+        m_state[1]^=m_state[2];
+        m_state[0]^=m_state[3];
+        m_state[2]^=shifted;
+        m_state[3]=rotateLeft(m_state[3], 45);
+
+        return result;
+    }
+
+    /**
+      * Returns a uniformly distributed integer without modulo bias.
+      * @param1 bound (nonzero)
+      * @return random integer from 0 to bound-1
+      */
+    inline uint64_t nextBounded(const uint64_t bound)
+    {
+        // multiply into 128 bits and reject the few products that would favour some results
+        unsigned __int128 product=(unsigned __int128)next()*bound;
+        uint64_t low=(uint64_t)product;
+        if (low<bound)
+        {
+            const uint64_t threshold=-bound%bound;
+            while (low<threshold)
+            {
+                product=(unsigned __int128)next()*bound;
+                low=(uint64_t)product;
+            }
+        }
+        return product>>64;
+    }
+
+    /**
+      * Returns a uniformly distributed double from [0,1).
+      */
+    inline double nextDouble() {return (next()>>11)*(1.0/9007199254740992.0);}
+
+    /**
+      * Advances the generator by 2^128 numbers.
+      */
+    void jump();
+
+    /**
+      * Advances the generator by 2^192 numbers.
+      */
+    void longJump();
+
+    /**
+      * Splits off an independent stream: returns a copy of the generator and jumps this one 2^128 numbers ahead.
+      * @return generator continuing the current stream
+      */
+    RandomGenerator split();
+};
+
+#endif // RANDOM_H
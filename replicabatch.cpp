@@ -0,0 +1,346 @@
+#include "replicabatch.h"
+#include "threadpool.h"
+#include "kernels.h"
+
+#include <algorithm>    /* fill, swap */
+
+ReplicaBatch::ReplicaBatch(const HopfieldNetwork& network, const unsigned long replicaCount, const uint64_t seed,
+                           const double activeProbability):
+    m_neuronWeights(network.getWeightStore()), m_denseWeights(NULL), m_bitMaskWeights(NULL),
+    m_neuronCount(network.getNeuronCount()),
+    m_replicaCount(replicaCount<MAX_BATCH_REPLICAS ? replicaCount : MAX_BATCH_REPLICAS),
+    m_neuronValues(network.getNeuronCount(), 0), m_neuronPotentials(network.getNeuronCount()*m_replicaCount, 0.0L),
+    m_temperatureModule(NULL), m_random(seed), m_acceptanceMode(network.getAcceptanceMode()),
+    m_sigmoidTable(network.getSigmoidTable()), m_rowBuffer(), m_linkNeurons(), m_linkWeights()
+{
+    m_denseWeights=dynamic_cast<const DenseWeightStore*>(m_neuronWeights.get());
+    m_bitMaskWeights=dynamic_cast<const BitMaskWeightStore*>(m_neuronWeights.get());
+    if (!m_denseWeights && !m_bitMaskWeights) m_rowBuffer.resize(m_neuronCount);
+
+    for (unsigned long i=0; i<m_neuronCount; i++)
+    {
+        for (unsigned long b=0; b<m_replicaCount; b++)
+        {
+            if (m_random.nextDouble()<activeProbability) m_neuronValues[i]|=uint64_t(1)<<b;
+        }
+    }
+    resetPotentials();
+}
+
+const double* ReplicaBatch::getRow(const unsigned long neuron)
+{
+    if (m_denseWeights) return m_denseWeights->getRow(neuron);
+
+    // gather the row from the links
+    std::fill(m_rowBuffer.begin(), m_rowBuffer.end(), 0.0L);
+    m_neuronWeights->getLinks(neuron, m_linkNeurons, m_linkWeights);
+    for (unsigned long link=0; link<m_linkNeurons.size(); link++) m_rowBuffer[m_linkNeurons[link]]=m_linkWeights[link];
+    m_rowBuffer[neuron]=m_neuronWeights->getWeight(neuron, neuron);
+    return &m_rowBuffer[0];
+}
+
+void ReplicaBatch::addRow(const unsigned long neuron, const double* factors, const uint64_t changes)
+{
+    const unsigned long replicaCount=m_replicaCount;
+
+    // few changed replicas are updated one by one, touching only their potentials
+    const unsigned long changeCount=__builtin_popcountll(changes);
+    const bool sparse=changeCount*MAX_BATCH_REPLICAS<=BATCH_SPARSE_CHANGES*replicaCount;
+    unsigned long changed[MAX_BATCH_REPLICAS];
+    unsigned long count=0;
+    if (sparse) for (uint64_t bits=changes; bits; bits&=bits-1) changed[count++]=__builtin_ctzll(bits);
+
+    if (m_bitMaskWeights)
+    {
+        // every mask is read once, its weight multiplied by the factors of all replicas
+        const unsigned long wordCount=m_bitMaskWeights->getWordCount();
+        for (unsigned long level=0; level<m_bitMaskWeights->getLevelCount(); level++)
+        {
+            double levelFactors[MAX_BATCH_REPLICAS];
+            for (unsigned long b=0; b<replicaCount; b++) levelFactors[b]=m_bitMaskWeights->getLevel(level)*factors[b];
+
+            const uint64_t* mask=m_bitMaskWeights->getMask(level, neuron);
+            for (unsigned long word=0; word<wordCount; word++)
+            {
+                for (uint64_t bits=mask[word]; bits; bits&=bits-1)
+                {
+                    double* potentials=&m_neuronPotentials[(word*STATE_WORD_BITS+__builtin_ctzll(bits))*replicaCount];
+                    if (sparse) for (unsigned long c=0; c<count; c++) potentials[changed[c]]+=levelFactors[changed[c]];
+                    else for (unsigned long b=0; b<replicaCount; b++) potentials[b]+=levelFactors[b];
+                }
+            }
+        }
+        return;
+    }
+
+    const double* weights=getRow(neuron);
+    if (sparse)
+    {
+        for (unsigned long j=0; j<m_neuronCount; j++)
+        {
+            if (j==neuron || !weights[j]) continue;
+            double* potentials=&m_neuronPotentials[j*replicaCount];
+            for (unsigned long c=0; c<count; c++) potentials[changed[c]]+=weights[j]*factors[changed[c]];
+        }
+        return;
+    }
+
+    // every weight is read once and added to the potentials of all replicas
+    for (unsigned long j=0; j<m_neuronCount; j++)
+    {
+        if (j==neuron || !weights[j]) continue;
+        const double weight=weights[j];
+        double* potentials=&m_neuronPotentials[j*replicaCount];
+        for (unsigned long b=0; b<replicaCount; b++) potentials[b]+=weight*factors[b];
+    }
+}
+
+void ReplicaBatch::multiplyRows(const vector<double>& values, const unsigned long first, const unsigned long last)
+{
+    const unsigned long replicaCount=m_replicaCount;
+
+    // weight[i][i] is the bias whatever the value of the neuron, the product counts it only if active
+    for (unsigned long i=first; i<last; i++)
+    {
+        const double bias=m_denseWeights->getRow(i)[i];
+        for (unsigned long b=0; b<replicaCount; b++)
+        {
+            m_neuronPotentials[i*replicaCount+b]=bias*(1.0L-values[i*replicaCount+b]);
+        }
+    }
+
+    // blocks of values stay in the cache while the rows of the range pass over them
+    for (unsigned long blockStart=0; blockStart<m_neuronCount; blockStart+=BATCH_BLOCK_SIZE)
+    {
+        const unsigned long blockEnd=blockStart+BATCH_BLOCK_SIZE<m_neuronCount ? blockStart+BATCH_BLOCK_SIZE : m_neuronCount;
+        for (unsigned long i=first; i<last; i++)
+        {
+            const double* weights=m_denseWeights->getRow(i);
+            double* potentials=&m_neuronPotentials[i*replicaCount];
+            for (unsigned long j=blockStart; j<blockEnd; j++)
+            {
+                const double weight=weights[j];
+                const double* column=&values[j*replicaCount];
+                for (unsigned long b=0; b<replicaCount; b++) potentials[b]+=weight*column[b];
+            }
+        }
+    }
+}
+
+void ReplicaBatch::multiplyMasks(const vector<uint64_t>& states, const unsigned long first, const unsigned long last)
+{
+    const unsigned long replicaCount=m_replicaCount;
+    const unsigned long wordCount=m_bitMaskWeights->getWordCount();
+
+    for (unsigned long i=first; i<last; i++)
+    {
+        // weight[i][i] is the bias whatever the value of the neuron, masks never contain the neuron itself
+        double* potentials=&m_neuronPotentials[i*replicaCount];
+        for (unsigned long b=0; b<replicaCount; b++) potentials[b]=m_bitMaskWeights->getBias(i);
+
+        // a mask is read from memory once and stays in the cache while it is matched with the states of all replicas
+        for (unsigned long level=0; level<m_bitMaskWeights->getLevelCount(); level++)
+        {
+            const uint64_t* mask=m_bitMaskWeights->getMask(level, i);
+            const double weight=m_bitMaskWeights->getLevel(level);
+            for (unsigned long b=0; b<replicaCount; b++)
+            {
+                potentials[b]+=weight*kernels::maskedCount(mask, &states[b*wordCount], wordCount);
+            }
+        }
+    }
+}
+
+void ReplicaBatch::resetPotentials(const unsigned int threadCount)
+{
+    if (m_bitMaskWeights)
+    {
+        // the states of replicas as bit strings laid out as the masks, one after another
+        const unsigned long wordCount=m_bitMaskWeights->getWordCount();
+        vector<uint64_t> states(m_replicaCount*wordCount, 0);
+        for (unsigned long i=0; i<m_neuronCount; i++)
+        {
+            for (uint64_t replicas=m_neuronValues[i]; replicas; replicas&=replicas-1)
+            {
+                states[__builtin_ctzll(replicas)*wordCount+i/STATE_WORD_BITS]|=uint64_t(1)<<(i%STATE_WORD_BITS);
+            }
+        }
+
+        // every thread takes a range of neurons
+        ThreadPool pool(threadCount);
+        const unsigned long workerCount=pool.getThreadCount();
+        for (unsigned long t=0; t<workerCount; t++)
+        {
+            const unsigned long first=t*m_neuronCount/workerCount, last=(t+1)*m_neuronCount/workerCount;
+            pool.submit([this, &states, first, last]{multiplyMasks(states, first, last);});
+        }
+        pool.wait();
+        return;
+    }
+
+    if (!m_denseWeights)
+    {
+        // calculate replica by replica
+        vector<double> potentials(m_neuronCount);
+        for (unsigned long b=0; b<m_replicaCount; b++)
+        {
+            m_neuronWeights->calculatePotentialRange(getNeuronValues(b), potentials, 0, m_neuronCount);
+            for (unsigned long i=0; i<m_neuronCount; i++) m_neuronPotentials[i*m_replicaCount+b]=potentials[i];
+        }
+        return;
+    }
+
+    // multiply the weights with the states, every thread taking a range of rows
+    vector<double> values(m_neuronCount*m_replicaCount);
+    for (unsigned long i=0; i<m_neuronCount; i++)
+    {
+        for (unsigned long b=0; b<m_replicaCount; b++) values[i*m_replicaCount+b]=(m_neuronValues[i]>>b)&1;
+    }
+
+    ThreadPool pool(threadCount);
+    const unsigned long workerCount=pool.getThreadCount();
+    for (unsigned long t=0; t<workerCount; t++)
+    {
+        const unsigned long first=t*m_neuronCount/workerCount, last=(t+1)*m_neuronCount/workerCount;
+        pool.submit([this, &values, first, last]{multiplyRows(values, first, last);});
+    }
+    pool.wait();
+}
+
+unsigned long ReplicaBatch::processNeuron(const unsigned long neuron)
+{
+    const bool hot=m_temperatureModule&&m_temperatureModule->isHot();
+    const double* potentials=&m_neuronPotentials[neuron*m_replicaCount];
+
+    // decide the neuron in every replica
+    uint64_t values=m_neuronValues[neuron];
+    for (unsigned long b=0; b<m_replicaCount; b++)
+    {
+        const double potential=potentials[b];
+        // if potential is zero, keep the value of the neuron
+        if (!potential) continue;
+
+        const bool value=hot ? sampleValue(potential, m_temperatureModule->getInverseTemperature()) : (potential>=0);
+        if (value) values|=uint64_t(1)<<b;
+        else values&=~(uint64_t(1)<<b);
+    }
+    if (hot) m_temperatureModule->coolDown();
+
+    const uint64_t changes=values^m_neuronValues[neuron];
+    if (!changes) return 0;
+    m_neuronValues[neuron]=values;
+
+    // one pass over the row updates the potentials of the replicas that have changed
+    double factors[MAX_BATCH_REPLICAS];
+    for (unsigned long b=0; b<m_replicaCount; b++)
+    {
+        factors[b]=((changes>>b)&1) ? (((values>>b)&1) ? 1.0L : -1.0L) : 0.0L;
+    }
+    addRow(neuron, factors, changes);
+
+    return __builtin_popcountll(changes);
+}
+
+// random permutation by Fisher-Yates shuffle
+inline vector<unsigned long> createPermutation(const unsigned long elementsCount, RandomGenerator& random)
+{
+    vector<unsigned long> result(elementsCount);
+    for (unsigned long i=0; i<elementsCount; i++) result[i]=i;
+    for (unsigned long i=elementsCount; i>1; i--) std::swap(result[i-1], result[random.nextBounded(i)]);
+    return result;
+}
+
+unsigned long ReplicaBatch::processSweep()
+{
+    const vector<unsigned long> permutation=createPermutation(m_neuronCount, m_random);
+
+    unsigned long changed=0;
+    for (unsigned long i=0; i<m_neuronCount; i++) changed+=processNeuron(permutation[i]);
+    return changed;
+}
+
+unsigned long ReplicaBatch::processSynchronously(const unsigned int threadCount)
+{
+    const bool hot=m_temperatureModule&&m_temperatureModule->isHot();
+    const double inverseTemperature=hot ? m_temperatureModule->getInverseTemperature() : 0.0L;
+
+    // decide all neurons of all replicas from the previous potentials
+    unsigned long changed=0;
+    for (unsigned long i=0; i<m_neuronCount; i++)
+    {
+        uint64_t values=m_neuronValues[i];
+        for (unsigned long b=0; b<m_replicaCount; b++)
+        {
+            const double potential=m_neuronPotentials[i*m_replicaCount+b];
+            // if potential is zero, keep the value of the neuron
+            if (!potential) continue;
+
+            const bool value=hot ? sampleValue(potential, inverseTemperature) : (potential>=0);
+            if (value) values|=uint64_t(1)<<b;
+            else values&=~(uint64_t(1)<<b);
+        }
+        changed+=__builtin_popcountll(values^m_neuronValues[i]);
+        m_neuronValues[i]=values;
+    }
+    if (hot) for (unsigned long i=0; i<m_neuronCount; i++) m_temperatureModule->coolDown();
+
+    if (changed) resetPotentials(threadCount);
+    return changed;
+}
+
+bool ReplicaBatch::computeRandomSeq(unsigned long* const maxSteps)
+{
+    unsigned long currentSteps=0;
+
+    while (maxSteps==NULL || *maxSteps==0 || currentSteps<*maxSteps)
+    {
+        // the sweep is cut short if it would exceed maxSteps
+        const vector<unsigned long> permutation=createPermutation(m_neuronCount, m_random);
+
+        bool changed=false;
+        for (unsigned long i=0; i<m_neuronCount; i++)
+        {
+            if (maxSteps!=NULL && *maxSteps!=0 && currentSteps==*maxSteps) return false; // maxSteps used up
+            currentSteps++;
+            if (processNeuron(permutation[i])) changed=true;
+        }
+
+        if (!changed)
+        {
+            // equilibrium attained in all replicas
+            if (maxSteps!=NULL && *maxSteps==0) *maxSteps=currentSteps;
+            return true;
+        }
+    }
+
+    // maxSteps used up
+    return false;
+}
+
+NeuronState ReplicaBatch::getNeuronValues(const unsigned long replica) const
+{
+    NeuronState result(m_neuronCount, false);
+    for (unsigned long i=0; i<m_neuronCount; i++) if ((m_neuronValues[i]>>replica)&1) result.set(i, true);
+    return result;
+}
+
+double ReplicaBatch::energy(const unsigned long replica) const
+{
+    // an active neuron contributes by its bias and half of the weights of links to other active neurons
+    double result=0.0;
+    for (unsigned long i=0; i<m_neuronCount; i++)
+    {
+        if ((m_neuronValues[i]>>replica)&1)
+        {
+            result-=0.5*(m_neuronPotentials[i*m_replicaCount+replica]+m_neuronWeights->getWeight(i, i));
+        }
+    }
+    return result;
+}
+
+HopfieldNetwork ReplicaBatch::getReplica(const unsigned long replica) const
+{
+    vector<bool> neuronValues(m_neuronCount);
+    for (unsigned long i=0; i<m_neuronCount; i++) neuronValues[i]=(m_neuronValues[i]>>replica)&1;
+    return HopfieldNetwork(m_neuronWeights, neuronValues);
+}
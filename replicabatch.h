@@ -0,0 +1,173 @@
+#ifndef REPLICABATCH_H
+#define REPLICABATCH_H
+
+#include <vector>       /* vector */
+#include <memory>       /* shared_ptr */
+
+#include <stdint.h>     /* uint64_t */
+
+#include "network.h"
+
+using std::vector;
+using std::shared_ptr;
+
+// maximal number of replicas of a ReplicaBatch, the values of a neuron in all of them take one word
+#define MAX_BATCH_REPLICAS 64
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// at most this many changed replicas out of MAX_BATCH_REPLICAS are updated one by one, skipping the others
+#define BATCH_SPARSE_CHANGES 8
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// number of neurons whose values are multiplied together by a synchronous update, to stay in the L2 cache
+#define BATCH_BLOCK_SIZE 256
+
+/**
+  * A batch of replicas of a network updated in lockstep, so that every weight read from memory serves all of them.
+  * The values and potentials are stored neuron by neuron, the replicas of a neuron next to each other: processing a
+  * neuron reads its row of weights once for the whole batch, and a synchronous update is a product of the weights
+  * matrix with the matrix of states. With a BitMaskWeightStore, as integer networks get, the masks take the place
+  * of the rows in both. Other stores have their rows gathered from the links when a neuron is processed, and their
+  * potentials recalculated replica by replica, so that a synchronous update shares no reads of weights.
+  */
+class ReplicaBatch
+{
+private:
+    shared_ptr<const WeightStore> m_neuronWeights;
+    const DenseWeightStore* m_denseWeights; // m_neuronWeights if dense, NULL otherwise
+    const BitMaskWeightStore* m_bitMaskWeights; // m_neuronWeights if bit masks, NULL otherwise
+    unsigned long m_neuronCount;
+    unsigned long m_replicaCount;
+
+    vector<uint64_t> m_neuronValues; // bit b of word i is the value of neuron i in replica b
+    vector<double> m_neuronPotentials; // potential of neuron i in replica b at i*replicaCount+b
+
+    TemperatureModule* m_temperatureModule; // shared by all replicas
+    RandomGenerator m_random;
+
+    acceptanceMode m_acceptanceMode; // that of the network, how values are decided at nonzero temperature
+    shared_ptr<const SigmoidTable> m_sigmoidTable; // that of the network, used by TABULATED_ACCEPTANCE
+
+    // row of weights gathered from the links if the weights are not dense
+    vector<double> m_rowBuffer;
+    vector<unsigned long> m_linkNeurons;
+    vector<double> m_linkWeights;
+
+    /**
+      * Decides the value of a neuron at nonzero temperature in the same way as the network, TRUE with probability
+      * 1/(1+exp(-2*potential/temperature)).
+      * @param1 potential of the neuron
+      * @param2 inverse temperature
+      * @return value of the neuron
+      */
+    inline bool sampleValue(const double potential, const double inverseTemperature)
+    {
+        return isAccepted(2*potential*inverseTemperature, m_random.nextDouble(), m_acceptanceMode,
+                          m_sigmoidTable.get());
+    }
+
+    /**
+      * Returns the weights of links of a neuron to all neurons, the bias included.
+      * @param1 position of the neuron
+      */
+    const double* getRow(const unsigned long);
+
+    /**
+      * Adds a row of weights, multiplied by a factor for every replica, to the potentials of all neurons but one.
+      * @param1 position of the neuron whose row is added
+      * @param2 factors of replicas
+      * @param3 replicas with a nonzero factor, as bits
+      */
+    void addRow(const unsigned long, const double*, const uint64_t);
+
+    /**
+      * Recalculates the potentials of all replicas from scratch.
+      * @param1 number of threads (if left default, the number of cores)
+      */
+    void resetPotentials(const unsigned int = 0);
+
+    /**
+      * Multiplies a range of rows of the weights matrix with the matrix of states.
+      * @param1 values of neurons as 0 or 1, replicas of a neuron next to each other
+      * @param2 first neuron of the range
+      * @param3 neuron after the last one of the range
+      */
+    void multiplyRows(const vector<double>&, const unsigned long, const unsigned long);
+
+    /**
+      * Same as multiplyRows for weights given by bit masks, counting the active neurons of every mask in all replicas.
+      * @param1 states of replicas as bit strings laid out as the masks, one after another
+      * @param2 first neuron of the range
+      * @param3 neuron after the last one of the range
+      */
+    void multiplyMasks(const vector<uint64_t>&, const unsigned long, const unsigned long);
+
+public:
+    /**
+      * Constructor of class ReplicaBatch. Replicas start from random states.
+      * @param1 network whose weights and acceptance mode are shared
+      * @param2 number of replicas, at most MAX_BATCH_REPLICAS
+      * @param3 seed
+      * @param4 probability that a neuron is initially active (default 0.5)
+      */
+    ReplicaBatch(const HopfieldNetwork&, const unsigned long, const uint64_t = 0, const double = 0.5L);
+
+    inline unsigned long getReplicaCount() const {return m_replicaCount;}
+
+    inline unsigned long getNeuronCount() const {return m_neuronCount;}
+
+    /**
+      * Uploads a TemperatureModule for all replicas to use, cooled down once per neuron processed in all of them.
+      */
+    void uploadTemperatureModule(TemperatureModule* const module) {m_temperatureModule=module;}
+
+    /**
+      * Processes a neuron in all replicas by reading its cached potentials and changing its values accordingly.
+      * @param1 position of the neuron
+      * @return number of replicas in which the value has changed
+      */
+    unsigned long processNeuron(const unsigned long);
+
+    /**
+      * Processes every neuron once in all replicas, in a random permutation.
+      * @return number of changed values, summed over replicas
+      */
+    unsigned long processSweep();
+
+    /**
+      * Updates all neurons of all replicas at once from the previous states and recalculates the potentials as
+      * a product of the weights matrix with the matrix of states.
+      * @param1 number of threads (if left default, the number of cores)
+      * @return number of changed values, summed over replicas
+      */
+    unsigned long processSynchronously(const unsigned int = 0);
+
+    /**
+      * Processes the replicas in random permutations until none of them changes during a sweep or the (optional)
+      * maximum number of steps is reached.
+      * @param1 (pointer to) maximum number of steps - infinite if NULL(default) - stores the number of steps taken if 0,
+      * a neuron processed in all replicas counting one step
+      * @return whether an equilibrium has been achieved
+      */
+    bool computeRandomSeq(unsigned long* const = NULL);
+
+    /**
+      * Returns the state of a replica.
+      * @param1 replica
+      */
+    NeuronState getNeuronValues(const unsigned long) const;
+
+    /**
+      * Returns the energy of a replica, computed from its cached potentials.
+      * @param1 replica
+      */
+    double energy(const unsigned long) const;
+
+    /**
+      * Returns a network with the shared weights in the state of a replica.
+      * @param1 replica
+      */
+    HopfieldNetwork getReplica(const unsigned long) const;
+};
+
+#endif // REPLICABATCH_H
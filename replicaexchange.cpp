@@ -0,0 +1,128 @@
+#include "replicaexchange.h"
+
+#include <thread>       /* thread, hardware_concurrency */
+#include <math.h>       /* exp, pow, HUGE_VAL */
+
+ReplicaExchange::ReplicaExchange(const HopfieldNetwork& network, const vector<double>& temperatures,
+                                 const stateValidator validator, const uint64_t seed, const unsigned int threadCount):
+    m_replicas(temperatures.size(), network), m_temperatureModules(temperatures.begin(), temperatures.end()),
+    m_ladder(), m_threadCount(threadCount), m_validator(validator),
+    m_bestEnergies(temperatures.size(), HUGE_VAL), m_bestStates(temperatures.size()), m_random(seed),
+    m_swapAttempts(temperatures.size(), 0), m_swapAcceptances(temperatures.size(), 0)
+{
+    if (!m_threadCount) m_threadCount=std::thread::hardware_concurrency();
+    if (!m_threadCount) m_threadCount=1;
+
+    // every replica starts at its own position of the ladder with an independent stream of random numbers
+    for (unsigned long i=0; i<m_replicas.size(); i++)
+    {
+        m_ladder.push_back(i);
+        m_replicas[i].uploadTemperatureModule(&m_temperatureModules[i]);
+        m_replicas[i].getRandomGenerator()=m_random.split();
+    }
+}
+
+vector<double> ReplicaExchange::createGeometricLadder(const double lowest, const double highest,
+                                                      const unsigned long count)
+{
+    vector<double> result;
+    result.reserve(count);
+    const double ratio=count>1 ? pow(highest/lowest, 1.0L/(count-1)) : 1.0L;
+    double temperature=lowest;
+    for (unsigned long i=0; i<count; i++, temperature*=ratio) result.push_back(temperature);
+    return result;
+}
+
+void ReplicaExchange::sweepReplicas(const unsigned long first, const unsigned long last, const unsigned long sweeps)
+{
+    for (unsigned long i=first; i<last; i++)
+    {
+        HopfieldNetwork& replica=m_replicas[i];
+        for (unsigned long sweep=0; sweep<sweeps; sweep++)
+        {
+            replica.processSweep();
+            if (m_validator && !m_validator(replica)) continue;
+
+            const double energy=replica.energy();
+            if (energy<m_bestEnergies[i])
+            {
+                m_bestEnergies[i]=energy;
+                m_bestStates[i]=replica.getNeuronValues();
+            }
+        }
+    }
+}
+
+void ReplicaExchange::exchangeTemperatures(const bool odd)
+{
+    for (unsigned long position=odd; position+1<m_ladder.size(); position+=2)
+    {
+        const unsigned long colder=m_ladder[position];
+        const unsigned long hotter=m_ladder[position+1];
+        m_swapAttempts[position]++;
+
+        // neurons are decided by 1/(1+exp(-2*potential/T)), so a replica samples states with probability
+        // proportional to exp(-2E/T) and the exchange is accepted with probability
+        // min(1, exp(2(b_cold-b_hot)(E_cold-E_hot))) for b=1/T
+        const double argument=2.0L*(m_temperatureModules[position].getInverseTemperature()
+                               -m_temperatureModules[position+1].getInverseTemperature())
+                *(m_replicas[colder].energy()-m_replicas[hotter].energy());
+        if (argument>=0 || m_random.nextDouble()<exp(argument))
+        {
+            m_swapAcceptances[position]++;
+            std::swap(m_ladder[position], m_ladder[position+1]);
+            m_replicas[hotter].uploadTemperatureModule(&m_temperatureModules[position]);
+            m_replicas[colder].uploadTemperatureModule(&m_temperatureModules[position+1]);
+        }
+    }
+}
+
+void ReplicaExchange::run(const unsigned long rounds, const unsigned long sweepsPerRound)
+{
+    const unsigned long replicaCount=m_replicas.size();
+    const unsigned long threadCount=m_threadCount<replicaCount ? m_threadCount : replicaCount;
+
+    for (unsigned long round=0; round<rounds; round++)
+    {
+        // every thread sweeps a contiguous range of replicas, the calling one takes the first range
+        vector<std::thread> threads;
+        threads.reserve(threadCount);
+        for (unsigned long t=1; t<threadCount; t++)
+        {
+            threads.push_back(std::thread(&ReplicaExchange::sweepReplicas, this,
+                                          t*replicaCount/threadCount, (t+1)*replicaCount/threadCount, sweepsPerRound));
+        }
+        sweepReplicas(0, replicaCount/(threadCount ? threadCount : 1), sweepsPerRound);
+        for (unsigned long t=0; t<threads.size(); t++) threads[t].join();
+
+        exchangeTemperatures(round&1);
+    }
+}
+
+double ReplicaExchange::getSwapAcceptanceRate(const unsigned long position) const
+{
+    return m_swapAttempts[position] ? (double)m_swapAcceptances[position]/m_swapAttempts[position] : 0.0L;
+}
+
+bool ReplicaExchange::isBestFound() const
+{
+    return getBestEnergy()<HUGE_VAL;
+}
+
+double ReplicaExchange::getBestEnergy() const
+{
+    double result=HUGE_VAL;
+    for (unsigned long i=0; i<m_bestEnergies.size(); i++) if (m_bestEnergies[i]<result) result=m_bestEnergies[i];
+    return result;
+}
+
+HopfieldNetwork ReplicaExchange::getBestNetwork() const
+{
+    unsigned long best=0;
+    for (unsigned long i=1; i<m_bestEnergies.size(); i++) if (m_bestEnergies[i]<m_bestEnergies[best]) best=i;
+
+    HopfieldNetwork result=m_replicas.empty() ? HopfieldNetwork() : getReplica(0);
+    result.uploadTemperatureModule(NULL);
+    if (!m_replicas.empty() && m_bestEnergies[best]<HUGE_VAL) result.setNeuronValues(m_bestStates[best]);
+    return result;
+}
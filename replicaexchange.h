@@ -0,0 +1,117 @@
+#ifndef REPLICAEXCHANGE_H
+#define REPLICAEXCHANGE_H
+
+#include <vector>       /* vector */
+#include <memory>       /* shared_ptr */
+
+#include "network.h"
+
+using std::vector;
+using std::shared_ptr;
+
+/**
+  * Parallel tempering: replicas of a network are swept at fixed temperatures of a ladder, each on one thread at a
+  * time, and neighbouring temperatures are periodically exchanged by the Metropolis criterion, so that states
+  * stuck at low temperature can escape through the hotter ones.
+  * All replicas share the weights of the original network. Temperatures not above ZERO_THRESHOLD make the replica
+  * greedy, as in the network itself.
+  */
+class ReplicaExchange
+{
+private:
+    vector<HopfieldNetwork> m_replicas;
+    vector<TemperatureModule> m_temperatureModules; // one for every position of the ladder, from the coldest
+    vector<unsigned long> m_ladder; // replica at every position of the ladder
+    unsigned int m_threadCount;
+
+    stateValidator m_validator; // decides which states can be the best one, NULL accepts all
+
+    // written by the threads, one element each
+    vector<double> m_bestEnergies; // best energy of a valid state seen by every replica, HUGE_VAL if none
+    vector<NeuronState> m_bestStates; // corresponding states
+
+    RandomGenerator m_random; // decides exchanges
+
+    vector<unsigned long> m_swapAttempts; // for every pair of neighbouring positions of the ladder
+    vector<unsigned long> m_swapAcceptances;
+
+    /**
+      * Sweeps a range of replicas and records their best valid states.
+      * @param1 first replica
+      * @param2 replica after the last one
+      * @param3 number of sweeps
+      */
+    void sweepReplicas(const unsigned long, const unsigned long, const unsigned long);
+
+    /**
+      * Attempts exchanges of temperatures between the neighbouring positions of the ladder starting at even or odd
+      * positions.
+      * @param1 whether to start at odd positions
+      */
+    void exchangeTemperatures(const bool);
+
+    // replicas point to the temperature modules, copying would leave them pointing to the original ones
+    ReplicaExchange(const ReplicaExchange&);
+    ReplicaExchange& operator= (const ReplicaExchange&);
+
+public:
+    /**
+      * Constructor of class ReplicaExchange
+      * @param1 network to be replicated, including its state
+      * @param2 temperatures of the ladder, from the coldest
+      * @param3 validator of states (if left default, every state is valid)
+      * @param4 seed of the replicas and of the exchanges
+      * @param5 number of threads (if left default, the number of cores)
+      */
+    ReplicaExchange(const HopfieldNetwork&, const vector<double>&, const stateValidator = NULL,
+                    const uint64_t = 0, const unsigned int = 0);
+
+    /**
+      * Creates a ladder of temperatures in geometric progression.
+      * @param1 lowest temperature
+      * @param2 highest temperature
+      * @param3 number of temperatures
+      * @return temperatures from the lowest
+      */
+    static vector<double> createGeometricLadder(const double, const double, const unsigned long);
+
+    /**
+      * Runs rounds of sweeps in parallel followed by attempts to exchange neighbouring temperatures.
+      * @param1 number of rounds
+      * @param2 number of sweeps of every replica in a round
+      */
+    void run(const unsigned long, const unsigned long);
+
+    inline unsigned long getReplicaCount() const {return m_replicas.size();}
+
+    /**
+      * Returns the replica currently at a given position of the ladder.
+      * @param1 position, 0 being the coldest
+      */
+    inline const HopfieldNetwork& getReplica(const unsigned long position) const {return m_replicas[m_ladder[position]];}
+
+    /**
+      * Returns the rate of accepted exchanges between positions position and position+1 of the ladder.
+      * @param1 position
+      * @return accepted/attempted exchanges, 0 if none has been attempted
+      */
+    double getSwapAcceptanceRate(const unsigned long) const;
+
+    /**
+      * Returns whether a valid state has been seen.
+      */
+    bool isBestFound() const;
+
+    /**
+      * Returns the lowest energy of a valid state seen.
+      */
+    double getBestEnergy() const;
+
+    /**
+      * Returns a copy of the network in the best valid state seen (in the current state of the coldest replica if
+      * none has been seen).
+      */
+    HopfieldNetwork getBestNetwork() const;
+};
+
+#endif // REPLICAEXCHANGE_H
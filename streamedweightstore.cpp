@@ -0,0 +1,238 @@
+#include "streamedweightstore.h"
+#include "networkfile.h"
+#include "kernels.h"
+
+#include <algorithm>    /* fill */
+
+#include <fcntl.h>      /* open, posix_fadvise */
+#include <unistd.h>     /* pread, close */
+#include <sys/stat.h>   /* fstat */
+
+/**
+  * Reads a given number of bytes at a given position of a file, continuing after partial reads.
+  * @return whether all bytes have been read
+  */
+inline bool readFully(const int file, void* buffer, const uint64_t bytes, const uint64_t offset)
+{
+    uint64_t done=0;
+    while (done<bytes)
+    {
+        const ssize_t count=pread(file, static_cast<char*>(buffer)+done, bytes-done, offset+done);
+        if (count<=0) return false;
+        done+=count;
+    }
+    return true;
+}
+
+StreamedWeightStore::StreamedWeightStore(const int file, const unsigned long neuronCount, const uint64_t weightsOffset,
+                                         const unsigned long cacheCapacity, const vector<double>& biases):
+    WeightStore(neuronCount), m_file(file), m_weightsOffset(weightsOffset), m_rowStride(padWeights(neuronCount)),
+    m_cacheCapacity(cacheCapacity ? cacheCapacity : 1), m_biases(biases), m_mutex(), m_cachedRows(neuronCount), m_recentRows(),
+    m_recentPositions(neuronCount), m_cacheHits(0), m_cacheMisses(0)
+{
+}
+
+StreamedWeightStore* StreamedWeightStore::open(const char* path, const unsigned long cacheCapacity,
+                                               NeuronState* const neuronValues)
+{
+    const int file=::open(path, O_RDONLY);
+    if (file<0) return NULL;
+
+    // only the header and the values are read now
+    NetworkFileHeader header;
+    struct stat status;
+    if (fstat(file, &status) || !readFully(file, &header, sizeof(header), 0)
+            || !checkNetworkFileHeader(header, status.st_size) || header.layout!=DENSE_WEIGHTS)
+    {
+        ::close(file);
+        return NULL;
+    }
+
+    if (neuronValues)
+    {
+        vector<uint64_t> words((header.neuronCount+STATE_WORD_BITS-1)/STATE_WORD_BITS);
+        if (!words.empty() && !readFully(file, &words[0], words.size()*sizeof(uint64_t), header.valuesOffset))
+        {
+            ::close(file);
+            return NULL;
+        }
+        *neuronValues=NeuronState(words.empty() ? NULL : &words[0], header.neuronCount);
+    }
+
+    // the diagonal is read weight by weight
+    const unsigned long rowStride=padWeights(header.neuronCount);
+    vector<double> biases(header.neuronCount);
+    for (unsigned long i=0; i<header.neuronCount; i++)
+    {
+        if (!readFully(file, &biases[i], sizeof(double), header.weightsOffset+(i*rowStride+i)*sizeof(double)))
+        {
+            ::close(file);
+            return NULL;
+        }
+    }
+
+    // rows are read in no particular order
+    posix_fadvise(file, 0, 0, POSIX_FADV_RANDOM);
+    return new StreamedWeightStore(file, header.neuronCount, header.weightsOffset, cacheCapacity, biases);
+}
+
+StreamedWeightStore::~StreamedWeightStore()
+{
+    ::close(m_file);
+}
+
+StreamedWeightStore::Row StreamedWeightStore::getRow(const unsigned long neuron) const
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_cachedRows[neuron])
+        {
+            // move the row to the front of the recently used ones
+            m_cacheHits++;
+            m_recentRows.splice(m_recentRows.begin(), m_recentRows, m_recentPositions[neuron]);
+            return m_cachedRows[neuron];
+        }
+        m_cacheMisses++;
+    }
+
+    // read without holding the lock, so that other threads can use the cache meanwhile
+    vector<double>* row=new vector<double>(m_neuronCount);
+    Row result(row);
+    if (!readFully(m_file, &(*row)[0], m_neuronCount*sizeof(double), m_weightsOffset+neuron*m_rowStride*sizeof(double)))
+    {
+        raiseError(READ_FAILURE);
+        std::fill(row->begin(), row->end(), 0.0L);
+        return result;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_cachedRows[neuron]) return m_cachedRows[neuron]; // read by another thread meanwhile
+
+    if (m_recentRows.size()>=m_cacheCapacity)
+    {
+        // evict the least recently used row, whoever holds it keeps it until done
+        m_cachedRows[m_recentRows.back()].reset();
+        m_recentRows.pop_back();
+    }
+    m_recentRows.push_front(neuron);
+    m_recentPositions[neuron]=m_recentRows.begin();
+    m_cachedRows[neuron]=result;
+    return result;
+}
+
+unsigned long long StreamedWeightStore::getCacheHits() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cacheHits;
+}
+
+unsigned long long StreamedWeightStore::getCacheMisses() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cacheMisses;
+}
+
+void StreamedWeightStore::resetCacheCounters()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cacheHits=0;
+    m_cacheMisses=0;
+}
+
+double StreamedWeightStore::getWeight(const unsigned long i, const unsigned long j) const
+{
+    return i==j ? m_biases[i] : (*getRow(i))[j];
+}
+
+double StreamedWeightStore::calculatePotential(const unsigned long neuron, const NeuronState& neuronValues) const
+{
+    const Row row=getRow(neuron); // weights are symmetric, the row equals the column
+    const double* weights=&(*row)[0];
+    const uint64_t* bits=neuronValues.getWords();
+
+    // weight[i][i] is -bias, the weights of active neurons around it are summed
+    return weights[neuron]+kernels::maskedSum(weights, bits, 0, neuron)
+            +kernels::maskedSum(weights+neuron+1, bits, neuron+1, m_neuronCount-neuron-1);
+}
+
+void StreamedWeightStore::calculatePotentialRange(const NeuronState& neuronValues, vector<double>& potentials,
+                                                  const unsigned long first, const unsigned long last) const
+{
+    if (first>=last) return;
+
+    // the sum of the rows of active neurons reads every one of them once, the diagonal counting as the bias
+    for (unsigned long i=first; i<last; i++) potentials[i]=neuronValues[i] ? 0.0L : m_biases[i];
+    for (unsigned long j=neuronValues.findActive(0); j<m_neuronCount; j=neuronValues.findActive(j+1))
+    {
+        const Row row=getRow(j);
+        kernels::scaledAdd(&potentials[0]+first, 1.0L, &(*row)[0]+first, last-first);
+    }
+}
+
+void StreamedWeightStore::calculateInputRange(const vector<double>& values, vector<double>& inputs,
+                                              const unsigned long first, const unsigned long last) const
+{
+    if (first>=last) return;
+
+    // as in calculatePotentialRange, rows of neurons are summed, weighted by their values
+    for (unsigned long i=first; i<last; i++) inputs[i]=m_biases[i]*(1.0L-values[i]);
+    for (unsigned long j=0; j<m_neuronCount; j++)
+    {
+        if (!values[j]) continue;
+        const Row row=getRow(j);
+        kernels::scaledAdd(&inputs[0]+first, values[j], &(*row)[0]+first, last-first);
+    }
+}
+
+void StreamedWeightStore::updatePotentials(const unsigned long neuron, const double factor, vector<double>& potentials) const
+{
+    const Row row=getRow(neuron);
+    const double* weights=&(*row)[0];
+
+    // weight[i][i] is -bias and does not depend on the value
+    kernels::scaledAdd(&potentials[0], factor, weights, neuron);
+    kernels::scaledAdd(&potentials[0]+neuron+1, factor, weights+neuron+1, m_neuronCount-neuron-1);
+}
+
+void StreamedWeightStore::updatePotentialRange(const unsigned long neuron, const double factor,
+                                               vector<double>& potentials, const unsigned long first,
+                                               const unsigned long last) const
+{
+    const Row row=getRow(neuron);
+    const double* weights=&(*row)[0];
+
+    // the range is split by the neuron itself if it lies within
+    const unsigned long split=neuron<first ? first : (neuron>last ? last : neuron);
+    kernels::scaledAdd(&potentials[0]+first, factor, weights+first, split-first);
+    if (split<last)
+    {
+        const unsigned long rest=split==neuron ? split+1 : split;
+        kernels::scaledAdd(&potentials[0]+rest, factor, weights+rest, last-rest);
+    }
+}
+
+void StreamedWeightStore::getLinks(const unsigned long neuron, vector<unsigned long>& neurons,
+                                   vector<double>& weights) const
+{
+    const Row row=getRow(neuron);
+    neurons.clear();
+    weights.clear();
+    for (unsigned long i=0; i<m_neuronCount; i++)
+    {
+        if (i!=neuron && (*row)[i])
+        {
+            neurons.push_back(i);
+            weights.push_back((*row)[i]);
+        }
+    }
+}
+
+void StreamedWeightStore::prefetchRow(const unsigned long neuron) const
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_cachedRows[neuron]) return;
+    }
+    posix_fadvise(m_file, m_weightsOffset+neuron*m_rowStride*sizeof(double), m_neuronCount*sizeof(double),
+                  POSIX_FADV_WILLNEED);
+}
@@ -0,0 +1,107 @@
+#ifndef STREAMEDWEIGHTSTORE_H
+#define STREAMEDWEIGHTSTORE_H
+
+#include <vector>       /* vector */
+#include <list>         /* list */
+#include <memory>       /* shared_ptr */
+#include <mutex>        /* mutex, lock_guard */
+#include <stdint.h>     /* uint64_t */
+
+#include "weightstore.h"
+
+using std::vector;
+using std::list;
+using std::shared_ptr;
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// number of rows kept in memory by a StreamedWeightStore if not given
+#define DEFAULT_CACHED_ROWS 1024
+
+/**
+  * A weight store for weights matrices larger than the memory: the rows of a binary network file with
+  * DENSE_WEIGHTS (see networkfile.h) stay on disk and are read by pread when needed, the most recently used ones
+  * being kept in a cache of bounded size. Weights are symmetric, so a row is also a column and every operation
+  * needs only the rows of the neurons involved. Rows can be requested by many threads at the same time.
+  */
+class StreamedWeightStore: public WeightStore
+{
+private:
+    typedef shared_ptr<const vector<double> > Row; // held by readers, so that eviction does not free it under them
+
+    int m_file; // descriptor of the network file
+    uint64_t m_weightsOffset; // position of the first row in the file
+    unsigned long m_rowStride; // distance between starts of consecutive rows in weights
+    unsigned long m_cacheCapacity; // in rows
+    vector<double> m_biases; // weight[i][i] of every neuron, kept in memory so that they cost no reading of rows
+
+    mutable std::mutex m_mutex; // guards the cache and the counters
+    mutable vector<Row> m_cachedRows; // NULL if the row is not cached
+    mutable list<unsigned long> m_recentRows; // cached rows, the most recently used first
+    mutable vector<list<unsigned long>::iterator> m_recentPositions; // position of every cached row in m_recentRows
+    mutable unsigned long long m_cacheHits;
+    mutable unsigned long long m_cacheMisses;
+
+    StreamedWeightStore(const int, const unsigned long, const uint64_t, const unsigned long, const vector<double>&);
+
+    // weight stores are shared, not copied
+    StreamedWeightStore(const StreamedWeightStore&);
+    StreamedWeightStore& operator= (const StreamedWeightStore&);
+
+    /**
+      * Returns a row from the cache, reading it from the file if it is not there and evicting the least recently used.
+      * @param1 position of the neuron
+      * @return weights of links of the neuron to all neurons
+      */
+    Row getRow(const unsigned long) const;
+
+public:
+    /**
+      * Opens a binary network file with DENSE_WEIGHTS for streaming.
+      * @param1 path of the file
+      * @param2 number of rows to keep in memory (default DEFAULT_CACHED_ROWS)
+      * @param3 values of neurons stored in the file (output, if NULL(default), not read)
+      * @return new weight store or NULL if the file cannot be opened or is not a valid network file with DENSE_WEIGHTS
+      */
+    static StreamedWeightStore* open(const char*, const unsigned long = DEFAULT_CACHED_ROWS, NeuronState* const = NULL);
+
+    ~StreamedWeightStore();
+
+    inline unsigned long getCacheCapacity() const {return m_cacheCapacity;}
+
+    /**
+      * Returns the number of rows found in the cache.
+      */
+    unsigned long long getCacheHits() const;
+
+    /**
+      * Returns the number of rows read from the file.
+      */
+    unsigned long long getCacheMisses() const;
+
+    void resetCacheCounters();
+
+    double getWeight(const unsigned long, const unsigned long) const;
+
+    double calculatePotential(const unsigned long, const NeuronState&) const;
+
+    void calculatePotentialRange(const NeuronState&, vector<double>&, const unsigned long, const unsigned long) const;
+
+    void calculateInputRange(const vector<double>&, vector<double>&, const unsigned long, const unsigned long) const;
+
+    void updatePotentials(const unsigned long, const double, vector<double>&) const;
+
+    void updatePotentialRange(const unsigned long, const double, vector<double>&, const unsigned long,
+                              const unsigned long) const;
+
+    void getLinks(const unsigned long, vector<unsigned long>&, vector<double>&) const;
+
+    /**
+      * Asks the system to read a row that is not cached ahead of time, not waiting for it.
+      * @param1 position of the neuron
+      */
+    void prefetchRow(const unsigned long) const;
+
+    inline bool isInMemory() const {return false;}
+};
+
+#endif // STREAMEDWEIGHTSTORE_H
@@ -1,5 +1,7 @@
 #include "temperaturemodule.h"
 
+#include <limits.h> /* ULLONG_MAX */
+
 #define COMPUTED_LOGARITHMS_MAX_INDEX 2
 
 void ExpTemperatureModule::coolDown()
@@ -8,12 +10,33 @@ void ExpTemperatureModule::coolDown()
     {
         m_nextCoolDown+=m_qValue; // coolDown happens every q time steps
         m_temperature*=m_nValue; // raise exponenent of n
+        m_inverseTemperature*=m_inverseNValue;
+    }
+}
+
+void ExpTemperatureModule::advance(const unsigned long long steps)
+{
+    // time saturates rather than wraps, rejection-free computation can skip almost any number of steps
+    m_timeElapsed=steps>ULLONG_MAX-m_timeElapsed ? ULLONG_MAX : m_timeElapsed+steps;
+    if (m_timeElapsed>=m_nextCoolDown)
+    {
+        // coolDown happens every q time steps, all of those passed are applied at once
+        const unsigned long long coolDowns=(m_timeElapsed-m_nextCoolDown)/m_qValue+1;
+        m_nextCoolDown=coolDowns>(ULLONG_MAX-m_nextCoolDown)/m_qValue ? ULLONG_MAX : m_nextCoolDown+coolDowns*m_qValue;
+        m_temperature*=pow(m_nValue, (double)coolDowns);
+        m_inverseTemperature*=pow(m_inverseNValue, (double)coolDowns);
     }
 }
 
 void LogTemperatureModule::coolDown()
 {
-    m_temperature=m_initialTemperature / log1p(++m_timeElapsed); // new temperature value
+    setLogarithm(log1p(++m_timeElapsed)); // new temperature value
+}
+
+void LogTemperatureModule::advance(const unsigned long long steps)
+{
+    m_timeElapsed=steps>ULLONG_MAX-m_timeElapsed ? ULLONG_MAX : m_timeElapsed+steps;
+    setLogarithm(log1p(m_timeElapsed)); // new temperature value
 }
 
 vector<double> initializeComputedLogarithms(const unsigned short size = COMPUTED_LOGARITHMS_MAX_INDEX)
@@ -25,18 +48,27 @@ vector<double> initializeComputedLogarithms(const unsigned short size = COMPUTED
 
 void LogTemperatureModuleOpt::coolDown()
 {
-    static vector<double> computedLogarithms=initializeComputedLogarithms();
+    // every thread keeps its own logarithms, so that modules can cool down on many threads
+    thread_local static vector<double> computedLogarithms=initializeComputedLogarithms();
     // for the elements with indices <=computedCount we have data at the moment
-    static unsigned long long int computedCount=COMPUTED_LOGARITHMS_MAX_INDEX;
+    thread_local static unsigned long long int computedCount=COMPUTED_LOGARITHMS_MAX_INDEX;
 
     //bool first_run;
 
 
     m_timeElapsed++; // raise time
 
+    if (m_timeElapsed>computedCount+1)
+    {
+        // time has been advanced past the logarithms computed so far
+        setLogarithm(log1p(m_timeElapsed));
+        return;
+    }
+
     if (m_timeElapsed>computedCount)
     {
         // we don't have the data yet
+        computedCount++;
         if (m_timeElapsed&1)
         {
             // t=2k+1
@@ -46,10 +78,10 @@ void LogTemperatureModuleOpt::coolDown()
         {
             // t=2k
             // log t=log2 + log k
-            static long long k=COMPUTED_LOGARITHMS_MAX_INDEX/2; // the k that was last required
+            thread_local static long long k=COMPUTED_LOGARITHMS_MAX_INDEX/2; // the k that was last required
             computedLogarithms.push_back(computedLogarithms[++k]+computedLogarithms[2]);
         }
     }
 
-    m_temperature=m_initialTemperature / computedLogarithms[m_timeElapsed]; // new temperature value
+    setLogarithm(computedLogarithms[m_timeElapsed]); // new temperature value
 }
@@ -19,20 +19,36 @@ class TemperatureModule
 {
 protected:
     double m_temperature; // current temperature
+    double m_inverseTemperature; // 1/m_temperature, computed once per change of temperature
 
 public:
-    TemperatureModule(const double temperature = 0.0L):m_temperature(temperature){}
+    TemperatureModule(const double temperature = 0.0L):m_temperature(temperature), m_inverseTemperature(1.0L/temperature){}
+    virtual ~TemperatureModule(){}
+
+    /**
+      * Creates a copy of the module in its current state, e.g. for a copy of a network running on another thread.
+      * @return new module, to be deleted by the caller
+      */
+    virtual TemperatureModule* clone() const {return new TemperatureModule(*this);}
 
     // returns whether we consider the network cooled down
     virtual inline bool isHot() const {return m_temperature>ZERO_THRESHOLD;}
 
     virtual inline double getTemperature() const {return m_temperature;}
-    virtual inline void setTemperature(double temperature) {m_temperature=temperature;}
+    virtual inline double getInverseTemperature() const {return m_inverseTemperature;}
+    virtual inline void setTemperature(double temperature) {m_temperature=temperature; m_inverseTemperature=1.0L/temperature;}
 
     /**
       * Perform one step of cooling down. To be implemented properly in children.
       */
     virtual void coolDown(){}
+
+    /**
+      * Performs a given number of steps of cooling down at once, as if coolDown was called that many times.
+      * Children that cool down must implement it properly.
+      * @param1 number of steps
+      */
+    virtual void advance(const unsigned long long){}
 };
 
 
@@ -55,24 +71,30 @@ class ExpTemperatureModule: public TimeBasedTemperatureModule
 {
 private:
     double m_nValue; // value of n parameter
+    double m_inverseNValue; // 1/m_nValue
     unsigned int m_qValue; // value of q parameter
 
-    unsigned int m_nextCoolDown;
+    unsigned long long int m_nextCoolDown;
 
 public:
     ExpTemperatureModule(const double nValue, const unsigned int qValue, const double temperature = 0):
-        TimeBasedTemperatureModule(temperature), m_nValue(nValue), m_qValue(qValue), m_nextCoolDown(qValue){}
+        TimeBasedTemperatureModule(temperature), m_nValue(nValue), m_inverseNValue(1.0L/nValue), m_qValue(qValue),
+        m_nextCoolDown(qValue){}
 
     inline void setTemperature(double temperature)
     {TimeBasedTemperatureModule::setTemperature(temperature); m_nextCoolDown=m_qValue;}
 
+    TemperatureModule* clone() const {return new ExpTemperatureModule(*this);}
+
     /**
       * Perform one step of cooling down.
       */
     void coolDown();
 
-
-
+    /**
+      * Perform a given number of steps of cooling down at once.
+      */
+    void advance(const unsigned long long);
 };
 
 /**
@@ -82,24 +104,46 @@ class LogTemperatureModule: public TimeBasedTemperatureModule
 {
 protected:
     double m_initialTemperature;
+    double m_initialInverseTemperature; // 1/m_initialTemperature
+
+    /**
+      * Sets the temperature to T(0) / logarithm.
+      * @param1 log (1+t)
+      */
+    inline void setLogarithm(const double logarithm)
+    {m_temperature=m_initialTemperature / logarithm; m_inverseTemperature=logarithm*m_initialInverseTemperature;}
 
 public:
-    LogTemperatureModule(const double temperature):TimeBasedTemperatureModule(temperature), m_initialTemperature(temperature){}
+    LogTemperatureModule(const double temperature):TimeBasedTemperatureModule(temperature),
+        m_initialTemperature(temperature), m_initialInverseTemperature(1.0L/temperature){}
 
     inline void setTemperature(double temperature)
-    {TimeBasedTemperatureModule::setTemperature(temperature); m_initialTemperature=temperature;}
+    {
+        TimeBasedTemperatureModule::setTemperature(temperature);
+        m_initialTemperature=temperature;
+        m_initialInverseTemperature=1.0L/temperature;
+    }
+
+    TemperatureModule* clone() const {return new LogTemperatureModule(*this);}
 
     /**
       * Perform one step of cooling down.
       */
     virtual void coolDown();
 
+    /**
+      * Perform a given number of steps of cooling down at once.
+      */
+    void advance(const unsigned long long);
 };
 
 class LogTemperatureModuleOpt: public LogTemperatureModule
 {
 public:
     LogTemperatureModuleOpt(const double temperature):LogTemperatureModule(temperature){}
+
+    TemperatureModule* clone() const {return new LogTemperatureModuleOpt(*this);}
+
     /**
       * Perform one step of cooling down.
       */
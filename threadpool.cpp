@@ -0,0 +1,100 @@
+#include "threadpool.h"
+
+ThreadPool::ThreadPool(const unsigned int threadCount):
+    m_queues(), m_workers(), m_mutex(), m_taskAvailable(), m_tasksDone(),
+    m_queuedCount(0), m_pendingCount(0), m_nextQueue(0), m_stopping(false)
+{
+    unsigned int count=threadCount ? threadCount : std::thread::hardware_concurrency();
+    if (!count) count=1;
+
+    for (unsigned int i=0; i<count; i++) m_queues.push_back(shared_ptr<WorkQueue>(new WorkQueue()));
+    for (unsigned int i=0; i<count; i++) m_workers.push_back(std::thread(&ThreadPool::work, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping=true;
+    }
+    m_taskAvailable.notify_all();
+    for (unsigned long i=0; i<m_workers.size(); i++) m_workers[i].join();
+}
+
+void ThreadPool::submit(const function<void()>& task)
+{
+    WorkQueue& queue=*m_queues[m_nextQueue++%m_queues.size()];
+    m_pendingCount++;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+    {
+        // counted under the lock, so that a worker about to sleep cannot miss the notification
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queuedCount++;
+    }
+    m_taskAvailable.notify_one();
+}
+
+bool ThreadPool::takeTask(const unsigned long worker, function<void()>& task)
+{
+    // own queue first, newest task
+    {
+        WorkQueue& queue=*m_queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task=queue.tasks.back();
+            queue.tasks.pop_back();
+            m_queuedCount--;
+            return true;
+        }
+    }
+
+    // steal the oldest task of another worker
+    for (unsigned long i=1; i<m_queues.size(); i++)
+    {
+        WorkQueue& queue=*m_queues[(worker+i)%m_queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task=queue.tasks.front();
+            queue.tasks.pop_front();
+            m_queuedCount--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::work(const unsigned long worker)
+{
+    function<void()> task;
+    while (true)
+    {
+        if (takeTask(worker, task))
+        {
+            task();
+            task=function<void()>();
+            if (--m_pendingCount==0)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasksDone.notify_all();
+            }
+            continue;
+        }
+
+        // nothing to take, sleep until a task is submitted or the pool stops
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_taskAvailable.wait(lock, [this]{return m_stopping || m_queuedCount>0;});
+        if (m_stopping && m_queuedCount==0) return;
+    }
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_tasksDone.wait(lock, [this]{return m_pendingCount==0;});
+}
@@ -0,0 +1,89 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>               /* vector */
+#include <deque>                /* deque */
+#include <functional>           /* function */
+#include <thread>               /* thread */
+#include <mutex>                /* mutex, lock_guard, unique_lock */
+#include <condition_variable>   /* condition_variable */
+#include <atomic>               /* atomic */
+#include <memory>               /* shared_ptr */
+
+using std::vector;
+using std::deque;
+using std::function;
+using std::shared_ptr;
+
+/**
+  * A pool of threads with work stealing: every worker runs tasks from the back of its own queue and, once it is
+  * empty, steals from the front of the queues of the others, so that tasks of uneven length keep all threads busy.
+  */
+class ThreadPool
+{
+private:
+    /**
+      * Queue of tasks of one worker
+      */
+    struct WorkQueue
+    {
+        deque< function<void()> > tasks;
+        std::mutex mutex;
+    };
+
+    vector< shared_ptr<WorkQueue> > m_queues;
+    vector<std::thread> m_workers;
+
+    std::mutex m_mutex; // guards waiting for tasks and for their completion
+    std::condition_variable m_taskAvailable;
+    std::condition_variable m_tasksDone;
+
+    std::atomic<unsigned long> m_queuedCount; // tasks not yet taken from the queues
+    std::atomic<unsigned long> m_pendingCount; // tasks not yet finished
+    std::atomic<unsigned long> m_nextQueue; // queue to receive the next submitted task
+    bool m_stopping;
+
+    /**
+      * Takes a task, from the worker's own queue if possible.
+      * @param1 index of the worker
+      * @param2 task taken
+      * @return whether a task has been taken
+      */
+    bool takeTask(const unsigned long, function<void()>&);
+
+    /**
+      * Main loop of a worker.
+      * @param1 index of the worker
+      */
+    void work(const unsigned long);
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator= (const ThreadPool&);
+
+public:
+    /**
+      * Constructor of class ThreadPool
+      * @param1 number of threads (if left default, the number of cores)
+      */
+    ThreadPool(const unsigned int = 0);
+
+    /**
+      * Waits for the queued tasks to finish and stops the threads.
+      */
+    ~ThreadPool();
+
+    inline unsigned long getThreadCount() const {return m_workers.size();}
+
+    /**
+      * Queues a task, distributing tasks among the workers in turn.
+      * @param1 task
+      */
+    void submit(const function<void()>&);
+
+    /**
+      * Waits until all submitted tasks are finished.
+      */
+    void wait();
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,306 @@
+#include "tour.h"
+
+#include <algorithm>    /* sort, partial_sort, swap */
+#include <deque>        /* deque */
+#include <utility>      /* pair */
+
+using std::deque;
+using std::pair;
+
+// smallest gain of a move taken, so that rounding errors cannot make moves cycle
+#define TOUR_GAIN_EPSILON 1e-9
+
+vector<unsigned long> problems::decodeTour(const HopfieldNetwork& network, const unsigned long cityCount)
+{
+    vector<unsigned long> result;
+    if (network.getNeuronCount()!=cityCount*cityCount) return result;
+
+    const NeuronState& neuronValues=network.getNeuronValues();
+    vector<bool> listed(cityCount, false);
+    for (unsigned long step=0; step<cityCount; step++)
+    {
+        for (unsigned long city=0; city<cityCount; city++)
+        {
+            if (neuronValues[city*cityCount+step] && !listed[city])
+            {
+                listed[city]=true;
+                result.push_back(city);
+            }
+        }
+    }
+    return result;
+}
+
+void problems::repairTour(vector<unsigned long>& tour, const TSPInstance& instance)
+{
+    vector<bool> listed(instance.cityCount, false);
+    for (unsigned long i=0; i<tour.size(); i++) listed[tour[i]]=true;
+
+    for (unsigned long city=0; city<instance.cityCount; city++)
+    {
+        if (listed[city]) continue;
+        listed[city]=true;
+        if (tour.size()<2)
+        {
+            tour.push_back(city);
+            continue;
+        }
+
+        // cheapest insertion between two consecutive cities
+        unsigned long bestPosition=0;
+        double bestCost=0.0L;
+        for (unsigned long i=0; i<tour.size(); i++)
+        {
+            const unsigned long from=tour[i], to=tour[(i+1)%tour.size()];
+            const double cost=instance.getDistance(from, city)+instance.getDistance(city, to)
+                    -instance.getDistance(from, to);
+            if (i==0 || cost<bestCost)
+            {
+                bestCost=cost;
+                bestPosition=i+1;
+            }
+        }
+        tour.insert(tour.begin()+bestPosition, city);
+    }
+}
+
+double problems::getTourLength(const vector<unsigned long>& tour, const TSPInstance& instance)
+{
+    double result=0.0L;
+    for (unsigned long i=0; i<tour.size(); i++) result+=instance.getDistance(tour[i], tour[(i+1)%tour.size()]);
+    return result;
+}
+
+/**
+  * Local search over a tour held as an array with the position of every city, checking cities from a queue
+  * (those not in it have their don't-look bits set).
+  */
+class TourOptimizer
+{
+private:
+    const problems::TSPInstance& m_instance;
+    vector<unsigned long>& m_tour;
+    unsigned long m_cityCount;
+    vector<unsigned long> m_positions; // position of every city in m_tour
+    vector< vector<unsigned long> > m_neighbours; // nearest cities of every city, nearest first, found when needed
+    unsigned long m_neighbourCount;
+    deque<unsigned long> m_queue; // cities to check
+    vector<bool> m_queued;
+
+    inline double distance(const unsigned long from, const unsigned long to) const
+    {return m_instance.getDistance(from, to);}
+
+    inline unsigned long next(const unsigned long city) const {return m_tour[(m_positions[city]+1)%m_cityCount];}
+    inline unsigned long previous(const unsigned long city) const
+    {return m_tour[(m_positions[city]+m_cityCount-1)%m_cityCount];}
+
+    /**
+      * Returns the nearest cities of a city, finding them by partial sorting of its row of distances the first time.
+      */
+    const vector<unsigned long>& neighbours(const unsigned long city)
+    {
+        vector<unsigned long>& result=m_neighbours[city];
+        if (result.empty() && m_neighbourCount)
+        {
+            vector< pair<double, unsigned long> > candidates;
+            candidates.reserve(m_cityCount-1);
+            for (unsigned long other=0; other<m_cityCount; other++)
+            {
+                if (other!=city) candidates.push_back(pair<double, unsigned long>(distance(city, other), other));
+            }
+            std::partial_sort(candidates.begin(), candidates.begin()+m_neighbourCount, candidates.end());
+            for (unsigned long n=0; n<m_neighbourCount; n++) result.push_back(candidates[n].second);
+        }
+        return result;
+    }
+
+    inline void push(const unsigned long city)
+    {
+        if (m_queued[city]) return;
+        m_queued[city]=true;
+        m_queue.push_back(city);
+    }
+
+    /**
+      * Reverses the part of the tour from one city to another in the direction of the tour, or the rest of the tour
+      * if it is shorter, which gives the same tour traversed the other way.
+      */
+    void reverse(const unsigned long from, const unsigned long to)
+    {
+        unsigned long first=m_positions[from], last=m_positions[to];
+        unsigned long length=(last+m_cityCount-first)%m_cityCount+1;
+        if (2*length>m_cityCount)
+        {
+            const unsigned long restFirst=(last+1)%m_cityCount;
+            last=(first+m_cityCount-1)%m_cityCount;
+            first=restFirst;
+            length=m_cityCount-length;
+        }
+
+        for (unsigned long k=0; k<length/2; k++)
+        {
+            const unsigned long i=(first+k)%m_cityCount, j=(last+m_cityCount-k)%m_cityCount;
+            std::swap(m_tour[i], m_tour[j]);
+            m_positions[m_tour[i]]=i;
+            m_positions[m_tour[j]]=j;
+        }
+    }
+
+    /**
+      * Tries 2-opt moves replacing an edge of a city by an edge to one of its nearest cities.
+      * @return whether a move has been made
+      */
+    bool tryTwoOpt(const unsigned long a)
+    {
+        for (unsigned int forward=0; forward<2; forward++)
+        {
+            const unsigned long b=forward ? next(a) : previous(a);
+            const double removed=distance(a, b);
+            const vector<unsigned long>& nearest=neighbours(a);
+
+            for (unsigned long n=0; n<nearest.size(); n++)
+            {
+                const unsigned long c=nearest[n];
+                // the new edge has to be shorter than the removed one for the move to gain
+                if (distance(a, c)>=removed-TOUR_GAIN_EPSILON) break;
+
+                const unsigned long d=forward ? next(c) : previous(c);
+                if (c==b || d==a) continue;
+
+                const double gain=removed+distance(c, d)-distance(a, c)-distance(b, d);
+                if (gain<=TOUR_GAIN_EPSILON) continue;
+
+                // a b ... c d becomes a c ... b d, or backwards d c ... b a becomes d b ... c a
+                if (forward) reverse(b, c);
+                else reverse(c, b);
+                push(a);
+                push(b);
+                push(c);
+                push(d);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+      * Tries Or-opt moves taking a segment of up to OR_OPT_MAX_SEGMENT cities starting at a city and putting it,
+      * possibly reversed, next to one of the nearest cities of the city.
+      * @return whether a move has been made
+      */
+    bool tryOrOpt(const unsigned long first)
+    {
+        for (unsigned long length=1; length<=OR_OPT_MAX_SEGMENT && length+3<=m_cityCount; length++)
+        {
+            const unsigned long last=m_tour[(m_positions[first]+length-1)%m_cityCount];
+            const unsigned long before=previous(first), after=next(last);
+            const double removed=distance(before, first)+distance(last, after)-distance(before, after);
+            if (removed<=TOUR_GAIN_EPSILON) continue;
+            const vector<unsigned long>& nearest=neighbours(first);
+
+            for (unsigned long n=0; n<nearest.size(); n++)
+            {
+                const unsigned long c=nearest[n];
+                if (distance(first, c)>=removed-TOUR_GAIN_EPSILON) break;
+                if ((m_positions[c]+m_cityCount-m_positions[first])%m_cityCount<length) continue; // within the segment
+
+                // the segment goes either between c and its successor or between its predecessor and c
+                for (unsigned int side=0; side<2; side++)
+                {
+                    const unsigned long u=side ? previous(c) : c, v=side ? c : next(c);
+                    if (u==last || v==first) continue; // the edge is next to the segment
+
+                    // first joins c, the segment is reversed if c comes after it
+                    const double added=side ? distance(u, last)+distance(first, v)-distance(u, v)
+                                            : distance(u, first)+distance(last, v)-distance(u, v);
+                    if (removed-added<=TOUR_GAIN_EPSILON) continue;
+
+                    moveSegment(first, length, u, side);
+                    push(first);
+                    push(last);
+                    push(before);
+                    push(after);
+                    push(u);
+                    push(v);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+      * Moves a segment of the tour after a given city, rebuilding the array.
+      * @param1 first city of the segment
+      * @param2 length of the segment
+      * @param3 city after which the segment goes
+      * @param4 whether the segment is reversed
+      */
+    void moveSegment(const unsigned long first, const unsigned long length, const unsigned long u, const bool reversed)
+    {
+        vector<unsigned long> segment(length);
+        for (unsigned long k=0; k<length; k++) segment[k]=m_tour[(m_positions[first]+k)%m_cityCount];
+        if (reversed) std::reverse(segment.begin(), segment.end());
+
+        vector<unsigned long> result;
+        result.reserve(m_cityCount);
+        const unsigned long start=(m_positions[first]+length)%m_cityCount;
+        for (unsigned long k=0; k<m_cityCount-length; k++)
+        {
+            const unsigned long city=m_tour[(start+k)%m_cityCount];
+            result.push_back(city);
+            if (city==u) result.insert(result.end(), segment.begin(), segment.end());
+        }
+        m_tour.swap(result);
+        for (unsigned long i=0; i<m_cityCount; i++) m_positions[m_tour[i]]=i;
+    }
+
+public:
+    TourOptimizer(vector<unsigned long>& tour, const problems::TSPInstance& instance,
+                  const unsigned long neighbourCount):
+        m_instance(instance), m_tour(tour), m_cityCount(tour.size()), m_positions(instance.cityCount),
+        m_neighbours(instance.cityCount), m_neighbourCount(neighbourCount<m_cityCount-1 ? neighbourCount : m_cityCount-1),
+        m_queue(), m_queued(instance.cityCount, false)
+    {
+        for (unsigned long i=0; i<m_cityCount; i++) m_positions[m_tour[i]]=i;
+    }
+
+    /**
+      * Checks cities until no move shortens the tour.
+      * @param1 cities to check first, the others only once a move has changed their neighbours (if empty, all)
+      */
+    void run(const vector<unsigned long>& cities)
+    {
+        if (cities.empty()) for (unsigned long i=0; i<m_cityCount; i++) push(m_tour[i]);
+        for (unsigned long i=0; i<cities.size(); i++) push(cities[i]);
+        while (!m_queue.empty())
+        {
+            const unsigned long city=m_queue.front();
+            m_queue.pop_front();
+            m_queued[city]=false;
+            if (tryTwoOpt(city) || tryOrOpt(city)) push(city);
+        }
+    }
+};
+
+void problems::improveTour(vector<unsigned long>& tour, const TSPInstance& instance, const unsigned long neighbourCount,
+                           const vector<unsigned long>& cities)
+{
+    // smaller tours have nothing to improve
+    if (tour.size()<5 || tour.size()!=instance.cityCount) return;
+    TourOptimizer(tour, instance, neighbourCount).run(cities);
+}
+
+problems::TourResult problems::solveTour(const HopfieldNetwork& network, const TSPInstance& instance,
+                                         const unsigned long neighbourCount)
+{
+    TourResult result;
+    result.tour=decodeTour(network, instance.cityCount);
+    result.validState=result.tour.size()==instance.cityCount && isValidTour(network);
+    result.insertedCities=instance.cityCount-result.tour.size();
+
+    repairTour(result.tour, instance);
+    improveTour(result.tour, instance, neighbourCount);
+    result.length=getTourLength(result.tour, instance);
+    return result;
+}
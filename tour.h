@@ -0,0 +1,80 @@
+#ifndef TOUR_H
+#define TOUR_H
+
+#include <vector>       /* vector */
+
+#include "network.h"
+#include "problems.h"
+
+using std::vector;
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// number of nearest cities tried as new neighbours of a city by improveTour
+#define DEFAULT_NEIGHBOUR_COUNT 10
+
+// longest segment of cities moved by Or-opt
+#define OR_OPT_MAX_SEGMENT 3
+
+namespace problems
+{
+
+/**
+  * Outcome of turning the state of a TSP network into a tour
+  */
+struct TourResult
+{
+    vector<unsigned long> tour; // cities in order of visits
+    double length; // length of the closed tour
+    bool validState; // whether the state of the network has been a tour already
+    unsigned long insertedCities; // number of cities missing from the state and inserted by repairTour
+};
+
+/**
+  * Decodes the state of a TSP network step by step, listing the cities active at every step that have not been
+  * listed yet. The result is a tour if the state is valid, otherwise some cities may be missing.
+  * @param1 network created by createTSP
+  * @param2 number of cities
+  * @return cities in order of steps, each at most once
+  */
+vector<unsigned long> decodeTour(const HopfieldNetwork&, const unsigned long);
+
+/**
+  * Completes a partial tour by inserting every missing city where it lengthens the tour the least.
+  * @param1 tour (updated)
+  * @param2 cities
+  */
+void repairTour(vector<unsigned long>&, const TSPInstance&);
+
+/**
+  * Returns the length of a closed tour.
+  * @param1 tour
+  * @param2 cities
+  * @return length
+  */
+double getTourLength(const vector<unsigned long>&, const TSPInstance&);
+
+/**
+  * Improves a tour by 2-opt and Or-opt moves until none of them shortens it. Only moves joining a city to one of
+  * its nearest cities are tried, and a city is checked again only once a move has changed its neighbours
+  * (don't-look bits). The nearest cities of a city are found when it is first checked, so that a tour changed
+  * in a few places is improved without finding those of all cities.
+  * @param1 tour (updated)
+  * @param2 cities
+  * @param3 number of nearest cities tried (default DEFAULT_NEIGHBOUR_COUNT)
+  * @param4 cities checked first, the others only once a move has changed their neighbours (if left default, all)
+  */
+void improveTour(vector<unsigned long>&, const TSPInstance&, const unsigned long = DEFAULT_NEIGHBOUR_COUNT,
+                 const vector<unsigned long>& = vector<unsigned long>());
+
+/**
+  * Turns the state of a TSP network into a good tour: decodes it, repairs it and improves it.
+  * @param1 network created by createTSP for the cities
+  * @param2 cities
+  * @param3 number of nearest cities tried by improveTour (default DEFAULT_NEIGHBOUR_COUNT)
+  * @return tour, its length and whether the state has been valid
+  */
+TourResult solveTour(const HopfieldNetwork&, const TSPInstance&, const unsigned long = DEFAULT_NEIGHBOUR_COUNT);
+
+}
+
+#endif // TOUR_H
@@ -0,0 +1,279 @@
+#include "tsplib.h"
+#include "mappedfile.h"
+
+#include <string.h>     /* memcpy */
+#include <stdlib.h>     /* strtod, strtoul */
+
+using std::string;
+
+// longest number given to strtod when it cannot be parsed exactly by hand
+#define MAX_NUMBER_LENGTH 64
+
+// most decimal digits of a number parsed by hand, they fit into the mantissa of a double
+#define MAX_EXACT_DIGITS 15
+
+// powers of ten represented exactly by doubles
+static const double s_powersOfTen[23]={1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                       1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/**
+  * Formats of an EDGE_WEIGHT_SECTION
+  */
+enum edgeWeightFormat
+{
+    FULL_MATRIX = 0,
+    UPPER_ROW,
+    LOWER_ROW,
+    UPPER_DIAG_ROW,
+    LOWER_DIAG_ROW
+};
+
+/**
+  * Reads the tokens of a TSPLIB file held in memory, which need not end with a zero.
+  */
+class TSPLIBReader
+{
+private:
+    const char* m_position;
+    const char* m_end;
+
+    static inline bool isSpace(const char c) {return c==' ' || c=='\t' || c=='\r' || c=='\n' || c=='\v' || c=='\f';}
+
+    static inline bool isDigit(const char c) {return c>='0' && c<='9';}
+
+    inline void skipSpaces() {while (m_position<m_end && isSpace(*m_position)) m_position++;}
+
+    /**
+      * Parses a number by strtod from a copy ending with a zero.
+      * @param1 first character of the number
+      * @param2 number (output)
+      * @return whether the whole token is a number
+      */
+    bool parseNumber(const char*, double&);
+
+public:
+    TSPLIBReader(const char* data, const size_t size):m_position(data), m_end(data+size){}
+
+    inline bool atEnd() {skipSpaces(); return m_position==m_end;}
+
+    /**
+      * Returns whether the next token starts like a number.
+      */
+    inline bool isNumberNext()
+    {
+        skipSpaces();
+        return m_position<m_end && (isDigit(*m_position) || *m_position=='-' || *m_position=='+' || *m_position=='.');
+    }
+
+    /**
+      * Reads a keyword up to a space or a colon, and the colon following it if any.
+      */
+    string readKeyword();
+
+    /**
+      * Reads the rest of the line without the spaces around it.
+      */
+    string readValue();
+
+    /**
+      * Reads a number.
+      * @param1 number (output)
+      * @return whether a number has been read
+      */
+    bool readNumber(double&);
+};
+
+string TSPLIBReader::readKeyword()
+{
+    skipSpaces();
+    const char* start=m_position;
+    while (m_position<m_end && !isSpace(*m_position) && *m_position!=':') m_position++;
+    const string result(start, m_position);
+
+    // the colon may be separated by spaces on the same line
+    const char* after=m_position;
+    while (after<m_end && (*after==' ' || *after=='\t')) after++;
+    if (after<m_end && *after==':') m_position=after+1;
+    return result;
+}
+
+string TSPLIBReader::readValue()
+{
+    while (m_position<m_end && (*m_position==' ' || *m_position=='\t')) m_position++;
+    const char* start=m_position;
+    while (m_position<m_end && *m_position!='\n') m_position++;
+    const char* end=m_position;
+    while (end>start && isSpace(end[-1])) end--;
+    return string(start, end);
+}
+
+bool TSPLIBReader::parseNumber(const char* start, double& number)
+{
+    while (m_position<m_end && !isSpace(*m_position)) m_position++;
+    if (m_position-start>=MAX_NUMBER_LENGTH) return false;
+
+    char buffer[MAX_NUMBER_LENGTH];
+    memcpy(buffer, start, m_position-start);
+    buffer[m_position-start]=0;
+    char* end;
+    number=strtod(buffer, &end);
+    return end==buffer+(m_position-start) && end!=buffer;
+}
+
+bool TSPLIBReader::readNumber(double& number)
+{
+    skipSpaces();
+    const char* start=m_position;
+
+    bool negative=false;
+    if (m_position<m_end && (*m_position=='-' || *m_position=='+')) negative=(*m_position++=='-');
+
+    // the digits of the number as an integer and the power of ten it is scaled by
+    uint64_t mantissa=0;
+    int digits=0, exponent=0;
+    bool anyDigit=false;
+    for (; m_position<m_end && isDigit(*m_position); m_position++, anyDigit=true)
+    {
+        if (mantissa || *m_position!='0') digits++;
+        mantissa=mantissa*10+(*m_position-'0');
+        if (digits>MAX_EXACT_DIGITS) return parseNumber(start, number);
+    }
+    if (m_position<m_end && *m_position=='.')
+    {
+        for (m_position++; m_position<m_end && isDigit(*m_position); m_position++, anyDigit=true)
+        {
+            if (mantissa || *m_position!='0') digits++;
+            mantissa=mantissa*10+(*m_position-'0');
+            exponent--;
+            if (digits>MAX_EXACT_DIGITS) return parseNumber(start, number);
+        }
+    }
+    if (!anyDigit) return false;
+    if (m_position<m_end && !isSpace(*m_position)) return parseNumber(start, number); // exponent or not a number
+
+    // an exact integer multiplied or divided by an exact power of ten is rounded once, as by strtod
+    if (exponent<-22) return parseNumber(start, number);
+    number=exponent<0 ? (double)mantissa/s_powersOfTen[-exponent] : (double)mantissa;
+    if (negative) number=-number;
+    return true;
+}
+
+/**
+  * Parses a TSPLIB file.
+  * @param1 contents of the file
+  * @param2 size of the contents
+  * @param3 cities (output)
+  * @return errorCode (0=NO_ERROR)
+  */
+static errorCode parseTSPLIB(const char* data, const size_t size, problems::TSPInstance& instance)
+{
+    TSPLIBReader reader(data, size);
+    unsigned long dimension=0;
+    bool explicitWeights=false, coordinatesRead=false, weightsRead=false;
+    problems::distanceFunction function=problems::EUC_2D_DISTANCE;
+    edgeWeightFormat format=FULL_MATRIX;
+    double number;
+
+    while (!reader.atEnd())
+    {
+        const string keyword=reader.readKeyword();
+        if (keyword=="EOF") break;
+
+        if (keyword=="NODE_COORD_SECTION")
+        {
+            if (!dimension) return FILE_FORMAT;
+            instance.xCoordinates.resize(dimension);
+            instance.yCoordinates.resize(dimension);
+            for (unsigned long i=0; i<dimension; i++)
+            {
+                // the nodes are numbered from one
+                if (!reader.readNumber(number) || number<1 || number>dimension) return FILE_FORMAT;
+                const unsigned long node=(unsigned long)number-1;
+                if (!reader.readNumber(instance.xCoordinates[node]) || !reader.readNumber(instance.yCoordinates[node]))
+                {
+                    return FILE_FORMAT;
+                }
+            }
+            coordinatesRead=true;
+        }
+        else if (keyword=="EDGE_WEIGHT_SECTION")
+        {
+            if (!dimension || !explicitWeights) return FILE_FORMAT;
+            instance.distances.assign(dimension*dimension, 0.0f);
+            for (unsigned long i=0; i<dimension; i++)
+            {
+                const bool lower=(format==LOWER_ROW || format==LOWER_DIAG_ROW);
+                const bool diagonal=(format==UPPER_DIAG_ROW || format==LOWER_DIAG_ROW);
+                const unsigned long first=format==FULL_MATRIX || lower ? 0 : (diagonal ? i : i+1);
+                const unsigned long last=format==FULL_MATRIX || !lower ? dimension : (diagonal ? i+1 : i);
+                for (unsigned long j=first; j<last; j++)
+                {
+                    if (!reader.readNumber(number)) return FILE_FORMAT;
+                    instance.distances[i*dimension+j]=(float)number;
+                    if (format!=FULL_MATRIX) instance.distances[j*dimension+i]=(float)number;
+                }
+            }
+            weightsRead=true;
+        }
+        else if (keyword.size()>8 && keyword.compare(keyword.size()-8, 8, "_SECTION")==0)
+        {
+            // sections not needed, e.g. DISPLAY_DATA_SECTION, hold only numbers
+            while (reader.isNumberNext()) if (!reader.readNumber(number)) return FILE_FORMAT;
+        }
+        else
+        {
+            const string value=reader.readValue();
+            if (keyword=="DIMENSION")
+            {
+                char* end;
+                dimension=strtoul(value.c_str(), &end, 10);
+                if (*end || !dimension) return FILE_FORMAT;
+            }
+            else if (keyword=="EDGE_WEIGHT_TYPE")
+            {
+                explicitWeights=(value=="EXPLICIT");
+                if (value=="EUC_2D") function=problems::EUC_2D_DISTANCE;
+                else if (value=="CEIL_2D") function=problems::CEIL_2D_DISTANCE;
+                else if (value=="ATT") function=problems::ATT_DISTANCE;
+                else if (value=="GEO") function=problems::GEO_DISTANCE;
+                else if (!explicitWeights) return FILE_FORMAT;
+            }
+            else if (keyword=="EDGE_WEIGHT_FORMAT")
+            {
+                if (value=="FULL_MATRIX") format=FULL_MATRIX;
+                else if (value=="UPPER_ROW") format=UPPER_ROW;
+                else if (value=="LOWER_ROW") format=LOWER_ROW;
+                else if (value=="UPPER_DIAG_ROW") format=UPPER_DIAG_ROW;
+                else if (value=="LOWER_DIAG_ROW") format=LOWER_DIAG_ROW;
+                else if (value!="FUNCTION") return FILE_FORMAT;
+            }
+            // NAME, TYPE, COMMENT and the rest do not change the distances
+        }
+    }
+
+    if (explicitWeights ? !weightsRead : !coordinatesRead) return FILE_FORMAT;
+
+    instance.cityCount=dimension;
+    if (!explicitWeights) instance.computeDistances(function);
+    return NO_ERROR;
+}
+
+problems::TSPInstance problems::loadTSPLIB(const std::string fileName)
+{
+    TSPInstance result;
+    MappedFile file;
+    if (!file.open(fileName.c_str()))
+    {
+        raiseError(FILE_NOT_OPEN);
+        return result;
+    }
+
+    const errorCode error=parseTSPLIB(file.getData(), file.getSize(), result);
+    if (error)
+    {
+        // if the file cannot be used, raise an error and return no cities
+        raiseError(error);
+        return TSPInstance();
+    }
+    return result;
+}
@@ -0,0 +1,24 @@
+#ifndef TSPLIB_H
+#define TSPLIB_H
+
+#include <string>       /* string */
+
+#include "problems.h"
+
+namespace problems
+{
+
+/**
+  * Loads a travelling salesman problem from a file in the TSPLIB format. The file is mapped into memory and parsed
+  * in place. Supported are the edge weight types EUC_2D, CEIL_2D, ATT and GEO, whose distances are computed from the
+  * NODE_COORD_SECTION, and EXPLICIT with an EDGE_WEIGHT_SECTION in the formats FULL_MATRIX, UPPER_ROW, LOWER_ROW,
+  * UPPER_DIAG_ROW and LOWER_DIAG_ROW. Other sections are skipped.
+  * If the file cannot be opened or is not supported, an error is raised.
+  * @param1 name of the file
+  * @return cities, none if the file cannot be read
+  */
+TSPInstance loadTSPLIB(const std::string);
+
+}
+
+#endif // TSPLIB_H
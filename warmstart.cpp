@@ -0,0 +1,319 @@
+#include "warmstart.h"
+
+#include <algorithm>    /* swap */
+
+vector<unsigned long> problems::applyTSPChange(TSPInstance& instance, const TSPChange& change)
+{
+    vector<unsigned long> result;
+    const unsigned long oldCount=instance.cityCount;
+    const unsigned long movedCount=change.movedCities.size(), addedCount=change.addedXCoordinates.size();
+
+    // check the change before touching the cities
+    if (change.movedXCoordinates.size()!=movedCount || change.movedYCoordinates.size()!=movedCount
+            || change.addedYCoordinates.size()!=addedCount || (!instance.hasCoordinates() && (movedCount || addedCount)))
+    {
+        raiseError(INCONSISTENCY);
+        return result;
+    }
+    for (unsigned long i=0; i<change.removedCities.size(); i++)
+    {
+        if (change.removedCities[i]>=oldCount)
+        {
+            raiseError(OUT_OF_BOUNDS);
+            return result;
+        }
+    }
+    for (unsigned long i=0; i<movedCount; i++)
+    {
+        if (change.movedCities[i]>=oldCount)
+        {
+            raiseError(OUT_OF_BOUNDS);
+            return result;
+        }
+    }
+
+    // the remaining cities keep their order
+    result.assign(oldCount, 0);
+    for (unsigned long i=0; i<change.removedCities.size(); i++) result[change.removedCities[i]]=REMOVED_CITY;
+    vector<unsigned long> keptCities;
+    keptCities.reserve(oldCount);
+    for (unsigned long city=0; city<oldCount; city++)
+    {
+        if (result[city]==REMOVED_CITY) continue;
+        result[city]=keptCities.size();
+        keptCities.push_back(city);
+    }
+
+    // cities whose distances are computed, by their new indices
+    vector<unsigned long> changedCities;
+    for (unsigned long i=0; i<movedCount; i++)
+    {
+        const unsigned long city=change.movedCities[i];
+        if (result[city]==REMOVED_CITY) continue;
+        instance.xCoordinates[city]=change.movedXCoordinates[i];
+        instance.yCoordinates[city]=change.movedYCoordinates[i];
+        changedCities.push_back(result[city]);
+    }
+
+    if (keptCities.size()==oldCount && !addedCount)
+    {
+        // only moved, the matrix stays in place
+        instance.updateDistances(changedCities);
+        return result;
+    }
+
+    // the distances of the remaining cities are copied, those of the added ones computed
+    const unsigned long keptCount=keptCities.size(), newCount=keptCount+addedCount;
+    vector<float> distances(newCount*newCount);
+    for (unsigned long i=0; i<keptCount; i++)
+    {
+        const float* oldRow=&instance.distances[keptCities[i]*oldCount];
+        float* row=&distances[i*newCount];
+        for (unsigned long j=0; j<keptCount; j++) row[j]=oldRow[keptCities[j]];
+    }
+    instance.distances.swap(distances);
+
+    if (instance.hasCoordinates())
+    {
+        vector<double> xCoordinates(newCount), yCoordinates(newCount);
+        for (unsigned long i=0; i<keptCount; i++)
+        {
+            xCoordinates[i]=instance.xCoordinates[keptCities[i]];
+            yCoordinates[i]=instance.yCoordinates[keptCities[i]];
+        }
+        for (unsigned long i=0; i<addedCount; i++)
+        {
+            xCoordinates[keptCount+i]=change.addedXCoordinates[i];
+            yCoordinates[keptCount+i]=change.addedYCoordinates[i];
+            changedCities.push_back(keptCount+i);
+        }
+        instance.xCoordinates.swap(xCoordinates);
+        instance.yCoordinates.swap(yCoordinates);
+    }
+
+    instance.cityCount=newCount;
+    instance.updateDistances(changedCities);
+    return result;
+}
+
+vector<unsigned long> problems::carryTour(const vector<unsigned long>& tour, const vector<unsigned long>& cityMap,
+                                          const TSPInstance& instance)
+{
+    vector<unsigned long> result;
+    result.reserve(instance.cityCount);
+    for (unsigned long i=0; i<tour.size(); i++)
+    {
+        if (tour[i]<cityMap.size() && cityMap[tour[i]]!=REMOVED_CITY) result.push_back(cityMap[tour[i]]);
+    }
+    repairTour(result, instance);
+    return result;
+}
+
+/**
+  * Marks the cities next to marked ones in a tour.
+  * @param1 tour
+  * @param2 marked cities (updated)
+  */
+static void markNeighbours(const vector<unsigned long>& tour, vector<bool>& marked)
+{
+    const unsigned long size=tour.size();
+    vector<bool> neighbours(marked.size(), false);
+    for (unsigned long i=0; i<size; i++)
+    {
+        if (!marked[tour[i]]) continue;
+        neighbours[tour[(i+size-1)%size]]=true;
+        neighbours[tour[(i+1)%size]]=true;
+    }
+    for (unsigned long city=0; city<marked.size(); city++) if (neighbours[city]) marked[city]=true;
+}
+
+/**
+  * Improves a tour by improveTour starting from marked cities, if any.
+  * @param1 tour (updated)
+  * @param2 cities
+  * @param3 marked cities
+  */
+static void improveFrom(vector<unsigned long>& tour, const problems::TSPInstance& instance, const vector<bool>& marked)
+{
+    vector<unsigned long> startCities;
+    for (unsigned long city=0; city<marked.size(); city++) if (marked[city]) startCities.push_back(city);
+    if (!startCities.empty()) problems::improveTour(tour, instance, DEFAULT_NEIGHBOUR_COUNT, startCities);
+}
+
+/**
+  * Brings a TSP network to the state of a tour. The same closed tour can start at any step and go either way, so
+  * it is placed where the most of its cities are active already, e.g. after improveTour has rotated it. A flip
+  * updates the potentials of the neurons linked to it, about as many as a row of cities or steps has, so fewer
+  * differing neurons than cities are flipped one by one, otherwise all potentials are recalculated at once.
+  * @param1 network created by createTSP for the cities of the tour (updated)
+  * @param2 tour
+  */
+static void setTourState(HopfieldNetwork& network, const vector<unsigned long>& tour)
+{
+    const unsigned long cityCount=tour.size();
+    const NeuronState& neuronValues=network.getNeuronValues();
+
+    // every city votes for the start and direction that put it at a step where it is active
+    vector<unsigned long> activeSteps(cityCount, ULONG_MAX);
+    for (unsigned long i=neuronValues.findActive(0); i<neuronValues.size(); i=neuronValues.findActive(i+1))
+    {
+        activeSteps[i/cityCount]=i%cityCount;
+    }
+    vector<unsigned long> forwardVotes(cityCount, 0), backwardVotes(cityCount, 0);
+    for (unsigned long i=0; i<cityCount; i++)
+    {
+        const unsigned long step=activeSteps[tour[i]];
+        if (step==ULONG_MAX) continue;
+        forwardVotes[(step+cityCount-i)%cityCount]++;
+        backwardVotes[(step+i)%cityCount]++;
+    }
+    unsigned long start=0, bestVotes=0;
+    bool forward=true;
+    for (unsigned long i=0; i<cityCount; i++)
+    {
+        if (forwardVotes[i]>bestVotes)
+        {
+            start=i;
+            forward=true;
+            bestVotes=forwardVotes[i];
+        }
+        if (backwardVotes[i]>bestVotes)
+        {
+            start=i;
+            forward=false;
+            bestVotes=backwardVotes[i];
+        }
+    }
+
+    NeuronState tourValues(cityCount*cityCount);
+    for (unsigned long i=0; i<cityCount; i++)
+    {
+        const unsigned long step=forward ? (start+i)%cityCount : (start+cityCount-i)%cityCount;
+        tourValues.set(tour[i]*cityCount+step, true);
+    }
+
+    vector<unsigned long> differing;
+    for (unsigned long i=neuronValues.findActive(0); i<neuronValues.size() && differing.size()<cityCount;
+         i=neuronValues.findActive(i+1))
+    {
+        if (!tourValues[i]) differing.push_back(i);
+    }
+    for (unsigned long i=tourValues.findActive(0); i<tourValues.size() && differing.size()<cityCount;
+         i=tourValues.findActive(i+1))
+    {
+        if (!neuronValues[i]) differing.push_back(i);
+    }
+
+    if (differing.size()<cityCount)
+    {
+        for (unsigned long i=0; i<differing.size(); i++) network.setNeuronValue(differing[i], tourValues[differing[i]]);
+    }
+    else network.setNeuronValues(tourValues);
+}
+
+problems::TourResult problems::resolveTSP(TSPInstance& instance, const TSPChange& change,
+                                          const vector<unsigned long>& tour, HopfieldNetwork& network,
+                                          TemperatureModule* const module, const unsigned long sweeps,
+                                          const uint64_t seed)
+{
+    TourResult result;
+    result.length=0.0L;
+    result.validState=false;
+    result.insertedCities=0;
+
+    const TSPWeightStore* const weights=dynamic_cast<const TSPWeightStore*>(network.getWeightStore().get());
+    const unsigned long oldCount=instance.cityCount;
+    if (!weights || weights->getCityCount()!=oldCount)
+    {
+        raiseError(INCONSISTENCY);
+        return result;
+    }
+    const double delta=weights->getDelta();
+
+    const vector<unsigned long> cityMap=applyTSPChange(instance, change);
+    if (cityMap.empty()) return result;
+    const unsigned long cityCount=instance.cityCount;
+
+    // cities of the old tour next to removed ones lose a neighbour
+    vector<bool> affected(cityCount, false);
+    for (unsigned long i=0; i<tour.size(); i++)
+    {
+        if (tour[i]>=cityMap.size() || cityMap[tour[i]]!=REMOVED_CITY) continue;
+        const unsigned long before=tour[(i+tour.size()-1)%tour.size()], after=tour[(i+1)%tour.size()];
+        if (before<cityMap.size() && cityMap[before]!=REMOVED_CITY) affected[cityMap[before]]=true;
+        if (after<cityMap.size() && cityMap[after]!=REMOVED_CITY) affected[cityMap[after]]=true;
+    }
+
+    // the moved and added cities and their neighbours in the carried tour
+    const vector<unsigned long> carriedTour=carryTour(tour, cityMap, instance);
+    vector<bool> changed(cityCount, false);
+    vector<unsigned long> movedCities;
+    for (unsigned long i=0; i<change.movedCities.size(); i++)
+    {
+        const unsigned long city=cityMap[change.movedCities[i]];
+        if (city==REMOVED_CITY || changed[city]) continue;
+        changed[city]=true;
+        movedCities.push_back(city);
+    }
+    for (unsigned long city=cityCount-change.addedXCoordinates.size(); city<cityCount; city++) changed[city]=true;
+    markNeighbours(carriedTour, changed);
+    for (unsigned long city=0; city<cityCount; city++) if (changed[city]) affected[city]=true;
+
+    // with the same cities only the rows of the moved ones change, otherwise the network is created again
+    if (change.removedCities.empty() && change.addedXCoordinates.empty() && network.getWeightStore().use_count()==1)
+    {
+        vector<unsigned long> rows;
+        rows.reserve(movedCities.size()*cityCount);
+        for (unsigned long i=0; i<movedCities.size(); i++)
+        {
+            for (unsigned long step=0; step<cityCount; step++) rows.push_back(movedCities[i]*cityCount+step);
+        }
+        network.updateWeights(rows, [&](WeightStore& store)
+                              {static_cast<TSPWeightStore&>(store).updateDistances(movedCities, instance.distances);});
+        setTourState(network, carriedTour);
+    }
+    else network=createTSP(instance, delta, carriedTour);
+
+    // anneal only the neurons of the affected cities, in a new random order every sweep
+    TemperatureModule* const previousModule=network.getTemperatureModule();
+    network.setSeed(seed);
+    network.uploadTemperatureModule(module);
+    vector<unsigned long> neurons;
+    for (unsigned long city=0; city<cityCount; city++)
+    {
+        if (!affected[city]) continue;
+        for (unsigned long step=0; step<cityCount; step++) neurons.push_back(city*cityCount+step);
+    }
+    RandomGenerator& random=network.getRandomGenerator();
+    for (unsigned long sweep=0; sweep<sweeps; sweep++)
+    {
+        for (unsigned long i=neurons.size(); i>1; i--) std::swap(neurons[i-1], neurons[random.nextBounded(i)]);
+        for (unsigned long i=0; i<neurons.size(); i++) network.processNeuron(neurons[i]);
+    }
+
+    // only the affected cities can have changed their places, the search starts from them
+    result.tour=decodeTour(network, cityCount);
+    result.validState=result.tour.size()==cityCount && isValidTour(network);
+    result.insertedCities=cityCount-result.tour.size();
+    repairTour(result.tour, instance);
+    vector<bool> annealedAffected=affected;
+    markNeighbours(result.tour, annealedAffected);
+    improveFrom(result.tour, instance, annealedAffected);
+    result.length=getTourLength(result.tour, instance);
+
+    // a penalty too low for the distances makes the network drop cities, the carried tour may do better
+    vector<unsigned long> improvedTour=carriedTour;
+    markNeighbours(improvedTour, affected);
+    improveFrom(improvedTour, instance, affected);
+    const double improvedLength=getTourLength(improvedTour, instance);
+    if (improvedLength<result.length)
+    {
+        result.tour.swap(improvedTour);
+        result.length=improvedLength;
+    }
+
+    // the next change starts from the returned tour
+    network.uploadTemperatureModule(previousModule);
+    setTourState(network, result.tour);
+    return result;
+}
@@ -0,0 +1,86 @@
+#ifndef WARMSTART_H
+#define WARMSTART_H
+
+#include <stdint.h>     /* uint64_t */
+#include <limits.h>     /* ULONG_MAX */
+
+#include "tour.h"
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// sweeps over the neurons of the cities affected by a change, annealed by resolveTSP
+#define DEFAULT_WARM_START_SWEEPS 10
+
+// new index of a removed city
+#define REMOVED_CITY ULONG_MAX
+
+namespace problems
+{
+
+/**
+  * Change of the cities of a travelling salesman problem between two solves. Cities are given by their indices
+  * before the change.
+  */
+struct TSPChange
+{
+    vector<unsigned long> removedCities;
+    vector<unsigned long> movedCities;
+    vector<double> movedXCoordinates; // new coordinates of the moved cities
+    vector<double> movedYCoordinates;
+    vector<double> addedXCoordinates; // coordinates of new cities
+    vector<double> addedYCoordinates;
+
+    TSPChange():removedCities(), movedCities(), movedXCoordinates(), movedYCoordinates(), addedXCoordinates(),
+        addedYCoordinates(){}
+};
+
+/**
+  * Applies a change to cities. The remaining cities keep their order and the added ones follow them. Only the
+  * distances of moved and added cities are computed, by the distance function of the cities, the others are kept.
+  * Cities without coordinates can only be removed. If the change does not fit the cities, an error is raised and
+  * nothing is changed.
+  * @param1 cities (updated)
+  * @param2 change
+  * @return new index of every city, REMOVED_CITY for the removed ones, empty if nothing has been changed
+  */
+vector<unsigned long> applyTSPChange(TSPInstance&, const TSPChange&);
+
+/**
+  * Carries a tour over a change of cities: removed cities are left out, the others keep their order and the cities
+  * missing from it, e.g. the added ones, are inserted by repairTour.
+  * @param1 tour before the change
+  * @param2 new index of every city, as returned by applyTSPChange
+  * @param3 cities after the change
+  * @return tour of the changed cities
+  */
+vector<unsigned long> carryTour(const vector<unsigned long>&, const vector<unsigned long>&, const TSPInstance&);
+
+/**
+  * Solves a travelling salesman problem again after a change of its cities, starting from the previous tour
+  * (warm start). The change is applied and the tour is carried over it. If cities have only moved, the network of
+  * the previous solve is kept, unless its weights are shared with another network: the distances of the moved cities are updated in its weights in place, the
+  * potentials only for the neurons of their rows, and it is brought to the state of the tour by flipping the
+  * neurons that differ. If cities have been removed or added, the number of neurons changes and the network is
+  * created again by createTSP, which copies all distances. Only the neurons of the affected cities, the moved and
+  * added ones and those next to them or to the removed ones, are annealed, after which the state is repaired and
+  * improved by improveTour starting from the affected cities. The carried tour is improved in the same way and the
+  * shorter of the two is returned, as a penalty too low for the distances makes the network drop cities. The
+  * network is left in the state of the returned tour, ready for the next change. Only this last step, and
+  * decoding the state, grows with the number of neurons when cities have only moved: a city moved by improveTour
+  * shifts the steps of the cities between its old and new place, so the potentials are usually recalculated.
+  * @param1 cities (updated)
+  * @param2 change
+  * @param3 tour before the change
+  * @param4 network created by createTSP for the cities before the change (updated, if it is not in the state of
+  *         the tour, it is brought there)
+  * @param5 temperature module set to the low temperature to anneal at (if left default, zero temperature)
+  * @param6 sweeps over the neurons of the affected cities (default DEFAULT_WARM_START_SWEEPS)
+  * @param7 seed
+  * @return tour of the changed cities and its length, empty if the change does not fit the cities or the network
+  */
+TourResult resolveTSP(TSPInstance&, const TSPChange&, const vector<unsigned long>&, HopfieldNetwork&,
+                      TemperatureModule* const = NULL, const unsigned long = DEFAULT_WARM_START_SWEEPS,
+                      const uint64_t = 0);
+
+}
+
+#endif // WARMSTART_H
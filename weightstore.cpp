@@ -0,0 +1,797 @@
+#include "weightstore.h"
+#include "kernels.h"
+
+#include <algorithm>    /* lower_bound, find, swap, min */
+
+#include <stdlib.h>     /* posix_memalign, free */
+#include <math.h>       /* floor, fabs */
+#include <limits.h>     /* INT_MAX */
+#include <string.h>     /* memset */
+#include <new>          /* bad_alloc */
+
+/**
+  * Allocates a zeroed buffer aligned to WEIGHTS_ALIGNMENT.
+  * @param1 number of weights
+  * @return buffer to be released by free
+  */
+double* allocateWeights(const unsigned long count)
+{
+    void* result=NULL;
+    if (posix_memalign(&result, WEIGHTS_ALIGNMENT, count ? count*sizeof(double) : WEIGHTS_ALIGNMENT)) throw std::bad_alloc();
+    memset(result, 0, count*sizeof(double));
+    return static_cast<double*>(result);
+}
+
+double WeightStore::calculatePotential(const unsigned long neuron, const NeuronState& neuronValues) const
+{
+    double potential=getWeight(neuron, neuron); // weight[i][i] is -bias
+
+    for (unsigned long i=neuronValues.findActive(0); i<m_neuronCount; i=neuronValues.findActive(i+1))
+    {
+        if (i!=neuron) potential+=getWeight(neuron, i);
+    }
+    return potential;
+}
+
+void WeightStore::calculatePotentialRange(const NeuronState& neuronValues, vector<double>& potentials,
+                                          const unsigned long first, const unsigned long last) const
+{
+    for (unsigned long i=first; i<last; i++) potentials[i]=calculatePotential(i, neuronValues);
+}
+
+void WeightStore::calculateInputRange(const vector<double>& values, vector<double>& inputs,
+                                      const unsigned long first, const unsigned long last) const
+{
+    for (unsigned long i=first; i<last; i++)
+    {
+        double input=getWeight(i, i);
+        for (unsigned long j=0; j<m_neuronCount; j++) if (j!=i && values[j]) input+=getWeight(i, j)*values[j];
+        inputs[i]=input;
+    }
+}
+
+void WeightStore::updatePotentials(const unsigned long neuron, const double factor, vector<double>& potentials) const
+{
+    for (unsigned long i=0; i<m_neuronCount; i++)
+    {
+        if (i!=neuron) potentials[i]+=factor*getWeight(i, neuron);
+    }
+}
+
+void WeightStore::updatePotentialRange(const unsigned long neuron, const double factor, vector<double>& potentials,
+                                       const unsigned long first, const unsigned long last) const
+{
+    for (unsigned long i=first; i<last; i++)
+    {
+        if (i!=neuron) potentials[i]+=factor*getWeight(i, neuron);
+    }
+}
+
+double WeightStore::calculateEnergy(const NeuronState& neuronValues) const
+{
+    // every active neuron contributes by its bias and half of the weights of links to other active neurons
+    double energy=0.0;
+    for (unsigned long i=neuronValues.findActive(0); i<m_neuronCount; i=neuronValues.findActive(i+1))
+    {
+        energy-=0.5*(calculatePotential(i, neuronValues)+getWeight(i, i));
+    }
+    return energy;
+}
+
+void WeightStore::getLinks(const unsigned long neuron, vector<unsigned long>& neurons, vector<double>& weights) const
+{
+    neurons.clear();
+    weights.clear();
+    for (unsigned long i=0; i<m_neuronCount; i++)
+    {
+        const double weight=getWeight(neuron, i);
+        if (i!=neuron && weight)
+        {
+            neurons.push_back(i);
+            weights.push_back(weight);
+        }
+    }
+}
+
+
+DenseWeightStore::DenseWeightStore(const unsigned long neuronCount):
+    WeightStore(neuronCount), m_weights(NULL), m_rowStride(padWeights(neuronCount)), m_mappedFile()
+{
+    m_weights=allocateWeights(m_neuronCount*m_rowStride);
+}
+
+DenseWeightStore::DenseWeightStore(const vector< vector<double> >& weights):
+    WeightStore(weights.size()), m_weights(NULL), m_rowStride(padWeights(weights.size())), m_mappedFile()
+{
+    m_weights=allocateWeights(m_neuronCount*m_rowStride);
+    for (unsigned long i=0; i<m_neuronCount; i++) std::copy(weights[i].begin(), weights[i].end(), getRow(i));
+}
+
+DenseWeightStore::DenseWeightStore(const unsigned long neuronCount, double* weights,
+                                   const shared_ptr<const MappedFile>& mappedFile):
+    WeightStore(neuronCount), m_weights(weights), m_rowStride(padWeights(neuronCount)), m_mappedFile(mappedFile)
+{
+}
+
+DenseWeightStore::~DenseWeightStore()
+{
+    if (!m_mappedFile) free(m_weights);
+}
+
+bool DenseWeightStore::isSymmetric() const
+{
+    for (unsigned long i=0; i<m_neuronCount; i++)
+    {
+        for (unsigned long j=i+1; j<m_neuronCount; j++)
+        {
+            if (getRow(i)[j]!=getRow(j)[i]) return false;
+        }
+    }
+    return true;
+}
+
+double DenseWeightStore::calculatePotential(const unsigned long neuron, const NeuronState& neuronValues) const
+{
+    const double* weights=getRow(neuron);
+    const uint64_t* bits=neuronValues.getWords();
+
+    // weight[i][i] is -bias, the weights of active neurons around it are summed
+    return weights[neuron]+kernels::maskedSum(weights, bits, 0, neuron)
+            +kernels::maskedSum(weights+neuron+1, bits, neuron+1, m_neuronCount-neuron-1);
+}
+
+void DenseWeightStore::calculatePotentialRange(const NeuronState& neuronValues, vector<double>& potentials,
+                                               const unsigned long first, const unsigned long last) const
+{
+    // weights are symmetric, so the potentials are the sum of the rows of active neurons, which reads only those
+    // rows; blocks of potentials stay in the cache while the rows stream by
+    for (unsigned long blockStart=first; blockStart<last; blockStart+=POTENTIAL_BLOCK_SIZE)
+    {
+        const unsigned long blockEnd=blockStart+POTENTIAL_BLOCK_SIZE<last ? blockStart+POTENTIAL_BLOCK_SIZE : last;
+
+        // the sum includes weight[i][i] of an active neuron i, which counts as the bias whatever the value
+        for (unsigned long i=blockStart; i<blockEnd; i++) potentials[i]=neuronValues[i] ? 0.0L : getRow(i)[i];
+        for (unsigned long j=neuronValues.findActive(0); j<m_neuronCount; j=neuronValues.findActive(j+1))
+        {
+            kernels::scaledAdd(&potentials[0]+blockStart, 1.0L, getRow(j)+blockStart, blockEnd-blockStart);
+        }
+    }
+}
+
+void DenseWeightStore::calculateInputRange(const vector<double>& values, vector<double>& inputs,
+                                           const unsigned long first, const unsigned long last) const
+{
+    // as in calculatePotentialRange, rows of neurons are summed, weighted by their values
+    for (unsigned long blockStart=first; blockStart<last; blockStart+=POTENTIAL_BLOCK_SIZE)
+    {
+        const unsigned long blockEnd=blockStart+POTENTIAL_BLOCK_SIZE<last ? blockStart+POTENTIAL_BLOCK_SIZE : last;
+
+        // the sum includes weight[i][i] times the value of neuron i, while the bias counts fully
+        for (unsigned long i=blockStart; i<blockEnd; i++) inputs[i]=getRow(i)[i]*(1.0L-values[i]);
+        for (unsigned long j=0; j<m_neuronCount; j++)
+        {
+            if (values[j]) kernels::scaledAdd(&inputs[0]+blockStart, values[j], getRow(j)+blockStart, blockEnd-blockStart);
+        }
+    }
+}
+
+void DenseWeightStore::updatePotentials(const unsigned long neuron, const double factor, vector<double>& potentials) const
+{
+    const double* weights=getRow(neuron); // weights are symmetric, the row equals the column
+
+    // weight[i][i] is -bias and does not depend on the value
+    kernels::scaledAdd(&potentials[0], factor, weights, neuron);
+    kernels::scaledAdd(&potentials[0]+neuron+1, factor, weights+neuron+1, m_neuronCount-neuron-1);
+}
+
+void DenseWeightStore::updatePotentialRange(const unsigned long neuron, const double factor, vector<double>& potentials,
+                                            const unsigned long first, const unsigned long last) const
+{
+    const double* weights=getRow(neuron);
+
+    // the range is split by the neuron itself if it lies within
+    const unsigned long split=neuron<first ? first : (neuron>last ? last : neuron);
+    kernels::scaledAdd(&potentials[0]+first, factor, weights+first, split-first);
+    if (split<last)
+    {
+        const unsigned long rest=split==neuron ? split+1 : split;
+        kernels::scaledAdd(&potentials[0]+rest, factor, weights+rest, last-rest);
+    }
+}
+
+double DenseWeightStore::calculateEnergy(const NeuronState& neuronValues) const
+{
+    const uint64_t* bits=neuronValues.getWords();
+
+    // only rows of active neurons contribute to values^T weights values, biases are counted in it once
+    double product=0.0, biases=0.0;
+    for (unsigned long i=neuronValues.findActive(0); i<m_neuronCount; i=neuronValues.findActive(i+1))
+    {
+        product+=kernels::maskedSum(getRow(i), bits, 0, m_neuronCount);
+        biases+=getRow(i)[i];
+    }
+    return -0.5*(product+biases);
+}
+
+void DenseWeightStore::getLinks(const unsigned long neuron, vector<unsigned long>& neurons, vector<double>& weights) const
+{
+    const double* row=getRow(neuron);
+    neurons.clear();
+    weights.clear();
+    for (unsigned long i=0; i<m_neuronCount; i++)
+    {
+        if (i!=neuron && row[i])
+        {
+            neurons.push_back(i);
+            weights.push_back(row[i]);
+        }
+    }
+}
+
+
+PackedWeightStore::PackedWeightStore(const unsigned long neuronCount):
+    WeightStore(neuronCount), m_weights(NULL), m_rowStarts(neuronCount+1, 0), m_mappedFile()
+{
+    for (unsigned long i=0; i<m_neuronCount; i++) m_rowStarts[i+1]=m_rowStarts[i]+padWeights(m_neuronCount-i);
+    m_weights=allocateWeights(m_rowStarts.back());
+}
+
+PackedWeightStore::PackedWeightStore(const vector< vector<double> >& weights):
+    WeightStore(weights.size()), m_weights(NULL), m_rowStarts(weights.size()+1, 0), m_mappedFile()
+{
+    for (unsigned long i=0; i<m_neuronCount; i++) m_rowStarts[i+1]=m_rowStarts[i]+padWeights(m_neuronCount-i);
+    m_weights=allocateWeights(m_rowStarts.back());
+    for (unsigned long i=0; i<m_neuronCount; i++) std::copy(weights[i].begin()+i, weights[i].end(), getRow(i));
+}
+
+PackedWeightStore::PackedWeightStore(const unsigned long neuronCount, double* weights,
+                                     const shared_ptr<const MappedFile>& mappedFile):
+    WeightStore(neuronCount), m_weights(weights), m_rowStarts(neuronCount+1, 0), m_mappedFile(mappedFile)
+{
+    for (unsigned long i=0; i<m_neuronCount; i++) m_rowStarts[i+1]=m_rowStarts[i]+padWeights(m_neuronCount-i);
+}
+
+PackedWeightStore::~PackedWeightStore()
+{
+    if (!m_mappedFile) free(m_weights);
+}
+
+double PackedWeightStore::calculatePotential(const unsigned long neuron, const NeuronState& neuronValues) const
+{
+    const double* weights=getRow(neuron);
+    double potential=weights[0]; // weight[i][i] is -bias
+
+    // preceding active neurons hold the weight in their rows
+    for (unsigned long i=neuronValues.findActive(0); i<neuron; i=neuronValues.findActive(i+1))
+    {
+        potential+=getRow(i)[neuron-i];
+    }
+
+    // following neurons are in the row of the neuron
+    return potential+kernels::maskedSum(weights+1, neuronValues.getWords(), neuron+1, m_neuronCount-neuron-1);
+}
+
+void PackedWeightStore::updatePotentials(const unsigned long neuron, const double factor, vector<double>& potentials) const
+{
+    const double* weights=getRow(neuron);
+
+    for (unsigned long i=0; i<neuron; i++) potentials[i]+=factor*getRow(i)[neuron-i];
+    kernels::scaledAdd(&potentials[0]+neuron+1, factor, weights+1, m_neuronCount-neuron-1);
+}
+
+void PackedWeightStore::updatePotentialRange(const unsigned long neuron, const double factor, vector<double>& potentials,
+                                             const unsigned long first, const unsigned long last) const
+{
+    // neurons before the neuron hold the weight in their rows, the ones after it in the row of the neuron
+    for (unsigned long i=first; i<last && i<neuron; i++) potentials[i]+=factor*getRow(i)[neuron-i];
+
+    const unsigned long start=first>neuron ? first : neuron+1;
+    if (start<last) kernels::scaledAdd(&potentials[0]+start, factor, getRow(neuron)+(start-neuron), last-start);
+}
+
+double PackedWeightStore::calculateEnergy(const NeuronState& neuronValues) const
+{
+    const uint64_t* bits=neuronValues.getWords();
+
+    // each link is counted once from the upper triangle, together with the bias
+    double energy=0.0;
+    for (unsigned long i=neuronValues.findActive(0); i<m_neuronCount; i=neuronValues.findActive(i+1))
+    {
+        energy-=kernels::maskedSum(getRow(i), bits, i, m_neuronCount-i);
+    }
+    return energy;
+}
+
+
+SparseWeightStore::SparseWeightStore(const vector< vector<double> >& weights):
+    WeightStore(0), m_biases(), m_rowStarts(1, 0), m_linkNeurons(), m_linkWeights()
+{
+    for (unsigned long i=0; i<weights.size(); i++)
+    {
+        appendNeuron(weights[i][i]);
+        for (unsigned long j=0; j<weights.size(); j++)
+        {
+            if (i!=j && weights[i][j]) appendLink(j, weights[i][j]);
+        }
+    }
+}
+
+void SparseWeightStore::appendNeuron(const double bias)
+{
+    m_biases.push_back(bias);
+    m_rowStarts.push_back(m_rowStarts.back());
+    m_neuronCount++;
+}
+
+bool SparseWeightStore::isSymmetric() const
+{
+    for (unsigned long i=0; i<m_neuronCount; i++)
+    {
+        for (unsigned long link=m_rowStarts[i]; link<m_rowStarts[i+1]; link++)
+        {
+            if (getWeight(m_linkNeurons[link], i)!=m_linkWeights[link]) return false;
+        }
+    }
+    return true;
+}
+
+double SparseWeightStore::getWeight(const unsigned long i, const unsigned long j) const
+{
+    if (i==j) return m_biases[i];
+
+    // links of a neuron are sorted, search for the other neuron
+    const vector<unsigned int>::const_iterator begin=m_linkNeurons.begin()+m_rowStarts[i];
+    const vector<unsigned int>::const_iterator end=m_linkNeurons.begin()+m_rowStarts[i+1];
+    const vector<unsigned int>::const_iterator link=std::lower_bound(begin, end, j);
+
+    if (link!=end && *link==j) return m_linkWeights[link-m_linkNeurons.begin()];
+    return 0;
+}
+
+double SparseWeightStore::calculatePotential(const unsigned long neuron, const NeuronState& neuronValues) const
+{
+    double potential=m_biases[neuron];
+
+    for (unsigned long link=m_rowStarts[neuron]; link<m_rowStarts[neuron+1]; link++)
+    {
+        if (neuronValues[m_linkNeurons[link]]) potential+=m_linkWeights[link];
+    }
+    return potential;
+}
+
+void SparseWeightStore::calculateInputRange(const vector<double>& values, vector<double>& inputs,
+                                            const unsigned long first, const unsigned long last) const
+{
+    for (unsigned long i=first; i<last; i++)
+    {
+        double input=m_biases[i];
+        for (unsigned long link=m_rowStarts[i]; link<m_rowStarts[i+1]; link++)
+        {
+            input+=m_linkWeights[link]*values[m_linkNeurons[link]];
+        }
+        inputs[i]=input;
+    }
+}
+
+void SparseWeightStore::updatePotentials(const unsigned long neuron, const double factor, vector<double>& potentials) const
+{
+    // weights are symmetric, the links of the neuron are the links to the neuron
+    for (unsigned long link=m_rowStarts[neuron]; link<m_rowStarts[neuron+1]; link++)
+    {
+        potentials[m_linkNeurons[link]]+=factor*m_linkWeights[link];
+    }
+}
+
+void SparseWeightStore::updatePotentialRange(const unsigned long neuron, const double factor, vector<double>& potentials,
+                                             const unsigned long first, const unsigned long last) const
+{
+    for (unsigned long link=m_rowStarts[neuron]; link<m_rowStarts[neuron+1]; link++)
+    {
+        const unsigned long other=m_linkNeurons[link];
+        if (other>=first && other<last) potentials[other]+=factor*m_linkWeights[link];
+    }
+}
+
+void SparseWeightStore::getLinks(const unsigned long neuron, vector<unsigned long>& neurons, vector<double>& weights) const
+{
+    neurons.assign(m_linkNeurons.begin()+m_rowStarts[neuron], m_linkNeurons.begin()+m_rowStarts[neuron+1]);
+    weights.assign(m_linkWeights.begin()+m_rowStarts[neuron], m_linkWeights.begin()+m_rowStarts[neuron+1]);
+}
+
+
+BitMaskWeightStore::BitMaskWeightStore(const unsigned long neuronCount, const vector<double>& levels):
+    WeightStore(neuronCount), m_biases(neuronCount, 0), m_levels(levels),
+    m_wordCount((neuronCount+STATE_WORD_BITS-1)/STATE_WORD_BITS), m_masks(levels.size()*neuronCount*m_wordCount, 0)
+{
+}
+
+// whether a weight can be used by a BitMaskWeightStore
+inline bool isSmallInteger(const double weight)
+{
+    return weight==floor(weight) && fabs(weight)<=INT_MAX;
+}
+
+BitMaskWeightStore* BitMaskWeightStore::create(const WeightStore& weights)
+{
+    const unsigned long neuronCount=weights.getNeuronCount();
+    vector<double> levels;
+    vector<unsigned long> linkNeurons;
+    vector<double> linkWeights;
+    unsigned long linkCount=0;
+
+    // find the distinct weights, giving up as soon as the weights do not qualify
+    for (unsigned long i=0; i<neuronCount; i++)
+    {
+        if (!isSmallInteger(weights.getWeight(i, i))) return NULL;
+
+        weights.getLinks(i, linkNeurons, linkWeights);
+        linkCount+=linkNeurons.size();
+        for (unsigned long link=0; link<linkWeights.size(); link++)
+        {
+            if (std::find(levels.begin(), levels.end(), linkWeights[link])==levels.end())
+            {
+                if (!isSmallInteger(linkWeights[link]) || levels.size()==MAX_WEIGHT_LEVELS) return NULL;
+                levels.push_back(linkWeights[link]);
+            }
+        }
+    }
+
+    // masks take a bit per level and pair of neurons
+    const double maskMemory=levels.size()*(neuronCount/8.0)*neuronCount;
+    if (maskMemory>MASK_MEMORY_FACTOR*8.0*linkCount) return NULL;
+
+    BitMaskWeightStore* result=new BitMaskWeightStore(neuronCount, levels);
+    for (unsigned long i=0; i<neuronCount; i++)
+    {
+        result->m_biases[i]=weights.getWeight(i, i);
+
+        weights.getLinks(i, linkNeurons, linkWeights);
+        for (unsigned long link=0; link<linkNeurons.size(); link++)
+        {
+            const unsigned long level=std::find(levels.begin(), levels.end(), linkWeights[link])-levels.begin();
+            result->getWritableMask(level, i)[linkNeurons[link]/STATE_WORD_BITS]|=uint64_t(1)<<(linkNeurons[link]%STATE_WORD_BITS);
+        }
+    }
+    return result;
+}
+
+double BitMaskWeightStore::getWeight(const unsigned long i, const unsigned long j) const
+{
+    if (i==j) return m_biases[i];
+
+    for (unsigned long level=0; level<m_levels.size(); level++)
+    {
+        if ((getMask(level, i)[j/STATE_WORD_BITS]>>(j%STATE_WORD_BITS))&1) return m_levels[level];
+    }
+    return 0;
+}
+
+double BitMaskWeightStore::calculatePotential(const unsigned long neuron, const NeuronState& neuronValues) const
+{
+    double potential=m_biases[neuron]; // weight[i][i] is -bias
+
+    // masks never contain the neuron itself
+    for (unsigned long level=0; level<m_levels.size(); level++)
+    {
+        potential+=m_levels[level]*kernels::maskedCount(getMask(level, neuron), neuronValues.getWords(), m_wordCount);
+    }
+    return potential;
+}
+
+void BitMaskWeightStore::calculateInputRange(const vector<double>& values, vector<double>& inputs,
+                                             const unsigned long first, const unsigned long last) const
+{
+    for (unsigned long i=first; i<last; i++)
+    {
+        double input=m_biases[i];
+        for (unsigned long level=0; level<m_levels.size(); level++)
+        {
+            // sum the values of the neurons linked by the level, then weight them all at once
+            const uint64_t* mask=getMask(level, i);
+            double sum=0.0;
+            for (unsigned long word=0; word<m_wordCount; word++)
+            {
+                for (uint64_t bits=mask[word]; bits; bits&=bits-1) sum+=values[word*STATE_WORD_BITS+__builtin_ctzll(bits)];
+            }
+            input+=m_levels[level]*sum;
+        }
+        inputs[i]=input;
+    }
+}
+
+void BitMaskWeightStore::updatePotentials(const unsigned long neuron, const double factor, vector<double>& potentials) const
+{
+    // weights are symmetric, the mask of the neuron marks the neurons linked to it
+    for (unsigned long level=0; level<m_levels.size(); level++)
+    {
+        const double change=factor*m_levels[level];
+        const uint64_t* mask=getMask(level, neuron);
+        for (unsigned long word=0; word<m_wordCount; word++)
+        {
+            for (uint64_t bits=mask[word]; bits; bits&=bits-1)
+            {
+                potentials[word*STATE_WORD_BITS+__builtin_ctzll(bits)]+=change;
+            }
+        }
+    }
+}
+
+void BitMaskWeightStore::updatePotentialRange(const unsigned long neuron, const double factor, vector<double>& potentials,
+                                              const unsigned long first, const unsigned long last) const
+{
+    if (first>=last) return;
+
+    const unsigned long firstWord=first/STATE_WORD_BITS, lastWord=(last-1)/STATE_WORD_BITS;
+    for (unsigned long level=0; level<m_levels.size(); level++)
+    {
+        const double change=factor*m_levels[level];
+        const uint64_t* mask=getMask(level, neuron);
+        for (unsigned long word=firstWord; word<=lastWord; word++)
+        {
+            uint64_t bits=mask[word];
+            // cut off the neurons of the border words outside of the range
+            if (word==firstWord) bits&=~uint64_t(0)<<(first%STATE_WORD_BITS);
+            if (word==lastWord && last%STATE_WORD_BITS) bits&=~(~uint64_t(0)<<(last%STATE_WORD_BITS));
+            for (; bits; bits&=bits-1)
+            {
+                potentials[word*STATE_WORD_BITS+__builtin_ctzll(bits)]+=change;
+            }
+        }
+    }
+}
+
+void BitMaskWeightStore::getLinks(const unsigned long neuron, vector<unsigned long>& neurons, vector<double>& weights) const
+{
+    neurons.clear();
+    weights.clear();
+    for (unsigned long level=0; level<m_levels.size(); level++)
+    {
+        const uint64_t* mask=getMask(level, neuron);
+        for (unsigned long word=0; word<m_wordCount; word++)
+        {
+            for (uint64_t bits=mask[word]; bits; bits&=bits-1)
+            {
+                neurons.push_back(word*STATE_WORD_BITS+__builtin_ctzll(bits));
+                weights.push_back(m_levels[level]);
+            }
+        }
+    }
+}
+
+
+TSPWeightStore::TSPWeightStore(const unsigned long cityCount, const vector<float>& distances, const double delta):
+    WeightStore(cityCount*cityCount), m_cityCount(cityCount), m_distances(distances), m_delta(delta)
+{
+}
+
+void TSPWeightStore::updateDistances(const vector<unsigned long>& cities, const vector<float>& distances)
+{
+    for (unsigned long i=0; i<cities.size(); i++)
+    {
+        const unsigned long city=cities[i];
+        for (unsigned long other=0; other<m_cityCount; other++)
+        {
+            m_distances[city*m_cityCount+other]=distances[city*m_cityCount+other];
+            m_distances[other*m_cityCount+city]=distances[other*m_cityCount+city];
+        }
+    }
+}
+
+double TSPWeightStore::getWeight(const unsigned long i, const unsigned long j) const
+{
+    if (i==j) return m_delta/2.0;
+
+    const unsigned long iCity=i/m_cityCount, iStep=i%m_cityCount;
+    const unsigned long jCity=j/m_cityCount, jStep=j%m_cityCount;
+
+    // same city or same step
+    if (iCity==jCity || iStep==jStep) return -m_delta;
+
+    // j is visited right after i
+    if (jStep==(iStep+1)%m_cityCount) return -getDistance(iCity, jCity);
+
+    // j is visited right before i
+    if (iStep==(jStep+1)%m_cityCount) return -getDistance(jCity, iCity);
+
+    return 0;
+}
+
+double TSPWeightStore::calculatePotential(const unsigned long neuron, const NeuronState& neuronValues) const
+{
+    const unsigned long city=neuron/m_cityCount, step=neuron%m_cityCount;
+    const unsigned long nextStep=(step+1)%m_cityCount, priorStep=(step+m_cityCount-1)%m_cityCount;
+
+    double potential=m_delta/2.0; // weight[i][i] is -bias
+
+    for (unsigned long other=0; other<m_cityCount; other++)
+    {
+        // other steps of the same city
+        if (other!=step && neuronValues[city*m_cityCount+other]) potential-=m_delta;
+
+        if (other!=city)
+        {
+            // other cities in the same step
+            if (neuronValues[other*m_cityCount+step]) potential-=m_delta;
+
+            // other cities in the neighbouring steps
+            if (neuronValues[other*m_cityCount+nextStep]) potential-=getDistance(city, other);
+            if (priorStep!=nextStep && neuronValues[other*m_cityCount+priorStep]) potential-=getDistance(other, city);
+        }
+    }
+    return potential;
+}
+
+void TSPWeightStore::calculatePotentialRange(const NeuronState& neuronValues, vector<double>& potentials,
+                                             const unsigned long first, const unsigned long last) const
+{
+    // listing the active neurons pays off while they are few, or at most two per city, e.g. for a row of a tour
+    const unsigned long activeCount=neuronValues.count();
+    if (activeCount>=last-first && activeCount>2*m_cityCount)
+    {
+        WeightStore::calculatePotentialRange(neuronValues, potentials, first, last);
+        return;
+    }
+
+    // active neurons of every city and step, and active cities of every step
+    vector<unsigned long> cityCounts(m_cityCount, 0), stepCounts(m_cityCount, 0);
+    vector< vector<unsigned long> > stepCities(m_cityCount);
+    for (unsigned long i=neuronValues.findActive(0); i<m_neuronCount; i=neuronValues.findActive(i+1))
+    {
+        cityCounts[i/m_cityCount]++;
+        stepCounts[i%m_cityCount]++;
+        stepCities[i%m_cityCount].push_back(i/m_cityCount);
+    }
+
+    // the same links as in calculatePotential, only the active cities of the neighbouring steps are visited
+    for (unsigned long neuron=first, city=first/m_cityCount, step=first%m_cityCount; neuron<last; neuron++)
+    {
+        const unsigned long nextStep=step+1<m_cityCount ? step+1 : 0;
+        const unsigned long self=neuronValues[neuron] ? 1 : 0;
+
+        double potential=m_delta/2.0-m_delta*(cityCounts[city]-self)-m_delta*(stepCounts[step]-self);
+        const vector<unsigned long>& nextCities=stepCities[nextStep];
+        for (unsigned long k=0; k<nextCities.size(); k++)
+        {
+            if (nextCities[k]!=city) potential-=getDistance(city, nextCities[k]);
+        }
+        potentials[neuron]=potential;
+
+        if (++step==m_cityCount)
+        {
+            step=0;
+            city++;
+        }
+    }
+
+    // the distances from the cities of the prior step are columns, they are read in rows for a block of cities
+    for (unsigned long blockCity=first/m_cityCount; blockCity*m_cityCount<last; blockCity+=TSP_POTENTIAL_BLOCK_CITIES)
+    {
+        const unsigned long blockEnd=std::min(blockCity+TSP_POTENTIAL_BLOCK_CITIES, m_cityCount);
+        for (unsigned long step=0; step<m_cityCount; step++)
+        {
+            const unsigned long nextStep=step+1<m_cityCount ? step+1 : 0, priorStep=step ? step-1 : m_cityCount-1;
+            if (priorStep==nextStep) continue;
+
+            const vector<unsigned long>& priorCities=stepCities[priorStep];
+            for (unsigned long k=0; k<priorCities.size(); k++)
+            {
+                const float* const row=&m_distances[priorCities[k]*m_cityCount];
+                for (unsigned long city=blockCity; city<blockEnd; city++)
+                {
+                    const unsigned long neuron=city*m_cityCount+step;
+                    if (neuron>=first && neuron<last && city!=priorCities[k]) potentials[neuron]-=row[city];
+                }
+            }
+        }
+    }
+}
+
+void TSPWeightStore::calculateInputRange(const vector<double>& values, vector<double>& inputs,
+                                         const unsigned long first, const unsigned long last) const
+{
+    for (unsigned long neuron=first; neuron<last; neuron++)
+    {
+        const unsigned long city=neuron/m_cityCount, step=neuron%m_cityCount;
+        const unsigned long nextStep=(step+1)%m_cityCount, priorStep=(step+m_cityCount-1)%m_cityCount;
+
+        // the same links as in calculatePotential, weighted by real values
+        double penalized=0.0, distances=0.0;
+        for (unsigned long other=0; other<m_cityCount; other++)
+        {
+            if (other!=step) penalized+=values[city*m_cityCount+other];
+            if (other!=city)
+            {
+                penalized+=values[other*m_cityCount+step];
+                distances+=getDistance(city, other)*values[other*m_cityCount+nextStep];
+                if (priorStep!=nextStep) distances+=getDistance(other, city)*values[other*m_cityCount+priorStep];
+            }
+        }
+        inputs[neuron]=m_delta/2.0-m_delta*penalized-distances;
+    }
+}
+
+void TSPWeightStore::updatePotentials(const unsigned long neuron, const double factor, vector<double>& potentials) const
+{
+    const unsigned long city=neuron/m_cityCount, step=neuron%m_cityCount;
+    const unsigned long nextStep=(step+1)%m_cityCount, priorStep=(step+m_cityCount-1)%m_cityCount;
+
+    const double penalty=factor*m_delta;
+
+    for (unsigned long other=0; other<m_cityCount; other++)
+    {
+        // other steps of the same city
+        if (other!=step) potentials[city*m_cityCount+other]-=penalty;
+
+        if (other!=city)
+        {
+            // other cities in the same step
+            potentials[other*m_cityCount+step]-=penalty;
+
+            // other cities in the neighbouring steps
+            potentials[other*m_cityCount+nextStep]-=factor*getDistance(city, other);
+            if (priorStep!=nextStep) potentials[other*m_cityCount+priorStep]-=factor*getDistance(other, city);
+        }
+    }
+}
+
+void TSPWeightStore::updatePotentialRange(const unsigned long neuron, const double factor, vector<double>& potentials,
+                                          const unsigned long first, const unsigned long last) const
+{
+    const unsigned long city=neuron/m_cityCount, step=neuron%m_cityCount;
+    const unsigned long nextStep=(step+1)%m_cityCount, priorStep=(step+m_cityCount-1)%m_cityCount;
+
+    const double penalty=factor*m_delta;
+
+    // the same links as in updatePotentials, skipping neurons out of the range
+    for (unsigned long other=0; other<m_cityCount; other++)
+    {
+        const unsigned long sameCity=city*m_cityCount+other;
+        if (other!=step && sameCity>=first && sameCity<last) potentials[sameCity]-=penalty;
+
+        if (other!=city)
+        {
+            const unsigned long sameStep=other*m_cityCount+step;
+            const unsigned long next=other*m_cityCount+nextStep, prior=other*m_cityCount+priorStep;
+            if (sameStep>=first && sameStep<last) potentials[sameStep]-=penalty;
+            if (next>=first && next<last) potentials[next]-=factor*getDistance(city, other);
+            if (priorStep!=nextStep && prior>=first && prior<last) potentials[prior]-=factor*getDistance(other, city);
+        }
+    }
+}
+
+void TSPWeightStore::getLinks(const unsigned long neuron, vector<unsigned long>& neurons, vector<double>& weights) const
+{
+    neurons.clear();
+    weights.clear();
+    const unsigned long city=neuron/m_cityCount, step=neuron%m_cityCount;
+    const unsigned long nextStep=(step+1)%m_cityCount, priorStep=(step+m_cityCount-1)%m_cityCount;
+
+    for (unsigned long other=0; other<m_cityCount; other++)
+    {
+        if (other==city)
+        {
+            // other steps of the same city
+            for (unsigned long otherStep=0; otherStep<m_cityCount; otherStep++)
+            {
+                if (otherStep==step) continue;
+                neurons.push_back(city*m_cityCount+otherStep);
+                weights.push_back(-m_delta);
+            }
+            continue;
+        }
+
+        // the same and the neighbouring steps of another city, in increasing order
+        unsigned long steps[3]={priorStep, step, nextStep};
+        if (steps[0]>steps[1]) std::swap(steps[0], steps[1]);
+        if (steps[1]>steps[2]) std::swap(steps[1], steps[2]);
+        if (steps[0]>steps[1]) std::swap(steps[0], steps[1]);
+        for (unsigned int k=0; k<3; k++)
+        {
+            if (k && steps[k]==steps[k-1]) continue;
+            const double weight=getWeight(neuron, other*m_cityCount+steps[k]);
+            if (!weight) continue;
+            neurons.push_back(other*m_cityCount+steps[k]);
+            weights.push_back(weight);
+        }
+    }
+}
@@ -0,0 +1,473 @@
+#ifndef WEIGHTSTORE_H
+#define WEIGHTSTORE_H
+
+#include <vector>       /* vector */
+#include <memory>       /* shared_ptr */
+
+#include "neuronstate.h"
+
+using std::vector;
+using std::shared_ptr;
+
+class MappedFile;
+
+// alignment of rows of weights matrices in bytes, a cache line
+#define WEIGHTS_ALIGNMENT 64
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// number of potentials computed together by DenseWeightStore::calculatePotentialRange, to stay in the L1 cache
+#define POTENTIAL_BLOCK_SIZE 2048
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// number of cities whose potentials TSPWeightStore::calculatePotentialRange updates together, so that the distances
+// from a city of the prior step are read in a row and the written potentials stay in the L1 cache
+#define TSP_POTENTIAL_BLOCK_CITIES 64
+
+// maximal number of distinct weights of links held by a BitMaskWeightStore
+#define MAX_WEIGHT_LEVELS 4
+
+// CAN BE A SUBJECT OF OPTIMIZATION
+// how many times more memory than 8 bytes per link the masks of a BitMaskWeightStore may take
+#define MASK_MEMORY_FACTOR 2
+
+/**
+  * Rounds a number of weights up so that it fills whole WEIGHTS_ALIGNMENT blocks.
+  * @param1 number of weights
+  * @return padded number of weights
+  */
+inline unsigned long padWeights(const unsigned long count)
+{
+    const unsigned long block=WEIGHTS_ALIGNMENT/sizeof(double);
+    return (count+block-1)/block*block;
+}
+
+/**
+  * Layouts in which weights of a network can be stored
+  */
+enum weightLayout
+{
+    DENSE_WEIGHTS = 0,
+    PACKED_WEIGHTS,
+    SPARSE_WEIGHTS
+};
+
+/**
+  * Base class of all weight stores.
+  * A weight store holds the symmetric weights of links between neurons, weight[i][i] being the bias of neuron i.
+  */
+class WeightStore
+{
+protected:
+    unsigned long m_neuronCount;
+
+public:
+    WeightStore(const unsigned long neuronCount = 0):m_neuronCount(neuronCount){}
+    virtual ~WeightStore(){}
+
+    inline unsigned long getNeuronCount() const {return m_neuronCount;}
+
+    /**
+      * Returns the weight of the link between two neurons.
+      * @param1 position of the first neuron
+      * @param2 position of the second neuron
+      * @return weight (bias if both positions are equal)
+      */
+    virtual double getWeight(const unsigned long, const unsigned long) const =0;
+
+    /**
+      * Calculates the potential of a given neuron, including bias. To be overridden by more efficient children.
+      * @param1 position of the neuron
+      * @param2 values of neurons
+      * @return potential
+      */
+    virtual double calculatePotential(const unsigned long, const NeuronState&) const;
+
+    /**
+      * Calculates the potentials of neurons in a given range, so that disjoint ranges can be calculated by different
+      * threads at the same time. To be overridden by more efficient children.
+      * @param1 values of neurons
+      * @param2 potentials (output, only the range is written)
+      * @param3 first neuron of the range
+      * @param4 neuron after the last one of the range
+      */
+    virtual void calculatePotentialRange(const NeuronState&, vector<double>&, const unsigned long,
+                                         const unsigned long) const;
+
+    /**
+      * Calculates the inputs of neurons in a given range for real values of neurons, weights times values plus bias,
+      * as used by continuous networks. Disjoint ranges can be calculated by different threads at the same time.
+      * To be overridden by more efficient children.
+      * @param1 values of neurons
+      * @param2 inputs (output, only the range is written)
+      * @param3 first neuron of the range
+      * @param4 neuron after the last one of the range
+      */
+    virtual void calculateInputRange(const vector<double>&, vector<double>&, const unsigned long,
+                                     const unsigned long) const;
+
+    /**
+      * Adds the weights of links to a given neuron, multiplied by a given factor, to the potentials of all other neurons.
+      * To be overridden by more efficient children.
+      * @param1 position of the neuron
+      * @param2 factor (+1 if the neuron has been activated, -1 if it has been deactivated)
+      * @param3 potentials to update
+      */
+    virtual void updatePotentials(const unsigned long, const double, vector<double>&) const;
+
+    /**
+      * Same as updatePotentials, but updates only the potentials of neurons in a given range, so that disjoint
+      * ranges can be updated by different threads at the same time. To be overridden by more efficient children.
+      * @param1 position of the neuron
+      * @param2 factor (+1 if the neuron has been activated, -1 if it has been deactivated)
+      * @param3 potentials to update
+      * @param4 first neuron of the range
+      * @param5 neuron after the last one of the range
+      */
+    virtual void updatePotentialRange(const unsigned long, const double, vector<double>&, const unsigned long,
+                                      const unsigned long) const;
+
+    /**
+      * Calculates the energy of the network with given values of neurons. To be overridden by more efficient children.
+      * @param1 values of neurons
+      * @return energy
+      */
+    virtual double calculateEnergy(const NeuronState&) const;
+
+    /**
+      * Lists the links of a given neuron to other neurons with nonzero weights. To be overridden by more efficient children.
+      * @param1 position of the neuron
+      * @param2 positions of the other neurons (output)
+      * @param3 weights of the links (output)
+      */
+    virtual void getLinks(const unsigned long, vector<unsigned long>&, vector<double>&) const;
+
+    /**
+      * Hints that the weights of links of a given neuron will be needed soon. Ignored by stores held in memory.
+      * @param1 position of the neuron
+      */
+    virtual void prefetchRow(const unsigned long) const {}
+
+    /**
+      * Returns whether the weights are held in memory allocated by the store, rather than mapped or streamed from
+      * a file. Only such stores are converted to other ones by networks.
+      */
+    virtual bool isInMemory() const {return true;}
+};
+
+
+/**
+  * A weight store that holds the full weights matrix in a single buffer, row by row.
+  * Every row starts on a WEIGHTS_ALIGNMENT boundary.
+  */
+class DenseWeightStore: public WeightStore
+{
+private:
+    double* m_weights; // weights of links between neurons
+    unsigned long m_rowStride; // distance between starts of consecutive rows
+    shared_ptr<const MappedFile> m_mappedFile; // file holding the weights if they are used in place, NULL otherwise
+
+    // weight stores are shared, not copied
+    DenseWeightStore(const DenseWeightStore&);
+    DenseWeightStore& operator= (const DenseWeightStore&);
+
+public:
+    /**
+      * Constructor of class DenseWeightStore with all weights zero.
+      * @param1 neuronCount
+      */
+    DenseWeightStore(const unsigned long);
+
+    /**
+      * Constructor of class DenseWeightStore
+      * @param1 weights
+      */
+    DenseWeightStore(const vector< vector<double> >&);
+
+    /**
+      * Constructor of class DenseWeightStore that uses weights mapped from a file in place. The rows have to be laid
+      * out as by the other constructors, every one padded by padWeights.
+      * @param1 neuronCount
+      * @param2 weights, aligned to WEIGHTS_ALIGNMENT
+      * @param3 mapped file holding the weights, kept open by the store
+      */
+    DenseWeightStore(const unsigned long, double*, const shared_ptr<const MappedFile>&);
+
+    ~DenseWeightStore();
+
+    /**
+      * Returns the weights of links of a given neuron to all neurons.
+      * @param1 position of the neuron
+      * @return row of the weights matrix
+      */
+    inline const double* getRow(const unsigned long neuron) const {return m_weights+neuron*m_rowStride;}
+    inline double* getRow(const unsigned long neuron) {return m_weights+neuron*m_rowStride;}
+
+    inline double getWeight(const unsigned long i, const unsigned long j) const {return getRow(i)[j];}
+
+    /**
+      * Checks whether the weights matrix is symmetric.
+      * @return whether the weights are symmetric
+      */
+    bool isSymmetric() const;
+
+    double calculatePotential(const unsigned long, const NeuronState&) const;
+
+    void calculatePotentialRange(const NeuronState&, vector<double>&, const unsigned long, const unsigned long) const;
+
+    void calculateInputRange(const vector<double>&, vector<double>&, const unsigned long, const unsigned long) const;
+
+    void updatePotentials(const unsigned long, const double, vector<double>&) const;
+
+    void updatePotentialRange(const unsigned long, const double, vector<double>&, const unsigned long,
+                              const unsigned long) const;
+
+    double calculateEnergy(const NeuronState&) const;
+
+    void getLinks(const unsigned long, vector<unsigned long>&, vector<double>&) const;
+
+    inline bool isInMemory() const {return !m_mappedFile;}
+};
+
+
+/**
+  * A weight store that holds only the upper triangle of the symmetric weights matrix in a single buffer, row by row.
+  * Row i holds the weights of links of neuron i to itself and all following neurons. Every row starts on a
+  * WEIGHTS_ALIGNMENT boundary.
+  */
+class PackedWeightStore: public WeightStore
+{
+private:
+    double* m_weights; // weights of links between neurons
+    vector<unsigned long> m_rowStarts; // position of the first weight of every row
+    shared_ptr<const MappedFile> m_mappedFile; // file holding the weights if they are used in place, NULL otherwise
+
+    // weight stores are shared, not copied
+    PackedWeightStore(const PackedWeightStore&);
+    PackedWeightStore& operator= (const PackedWeightStore&);
+
+public:
+    /**
+      * Constructor of class PackedWeightStore with all weights zero.
+      * @param1 neuronCount
+      */
+    PackedWeightStore(const unsigned long);
+
+    /**
+      * Constructor of class PackedWeightStore. Only the upper triangle of the weights is used.
+      * @param1 weights
+      */
+    PackedWeightStore(const vector< vector<double> >&);
+
+    /**
+      * Constructor of class PackedWeightStore that uses weights mapped from a file in place. The rows have to be laid
+      * out as by the other constructors, row i padded by padWeights(neuronCount-i).
+      * @param1 neuronCount
+      * @param2 weights, aligned to WEIGHTS_ALIGNMENT
+      * @param3 mapped file holding the weights, kept open by the store
+      */
+    PackedWeightStore(const unsigned long, double*, const shared_ptr<const MappedFile>&);
+
+    ~PackedWeightStore();
+
+    /**
+      * Returns the weights of links of a given neuron to itself and all following neurons.
+      * @param1 position of the neuron
+      * @return row of the upper triangle, starting with the bias
+      */
+    inline const double* getRow(const unsigned long neuron) const {return m_weights+m_rowStarts[neuron];}
+    inline double* getRow(const unsigned long neuron) {return m_weights+m_rowStarts[neuron];}
+
+    inline double getWeight(const unsigned long i, const unsigned long j) const
+    {return i<=j ? getRow(i)[j-i] : getRow(j)[i-j];}
+
+    double calculatePotential(const unsigned long, const NeuronState&) const;
+
+    void updatePotentials(const unsigned long, const double, vector<double>&) const;
+
+    void updatePotentialRange(const unsigned long, const double, vector<double>&, const unsigned long,
+                              const unsigned long) const;
+
+    double calculateEnergy(const NeuronState&) const;
+
+    inline bool isInMemory() const {return !m_mappedFile;}
+};
+
+
+/**
+  * A weight store that holds only the nonzero weights, row by row in compressed form, and biases separately.
+  * Neurons are added one by one by appendNeuron, each followed by the nonzero weights of its links.
+  */
+class SparseWeightStore: public WeightStore
+{
+private:
+    vector<double> m_biases; // weight[i][i] of every neuron
+    vector<unsigned long> m_rowStarts; // position of the first link of every neuron, followed by the total link count
+    vector<unsigned int> m_linkNeurons; // the other neuron of every link
+    vector<double> m_linkWeights; // weight of every link
+
+public:
+    SparseWeightStore():WeightStore(0), m_biases(), m_rowStarts(1, 0), m_linkNeurons(), m_linkWeights(){}
+
+    /**
+      * Constructor of class SparseWeightStore that keeps the nonzero weights of a full weights matrix.
+      * @param1 weights
+      */
+    SparseWeightStore(const vector< vector<double> >&);
+
+    /**
+      * Adds a neuron with no links.
+      * @param1 bias of the neuron
+      */
+    void appendNeuron(const double);
+
+    /**
+      * Adds a link of the last added neuron. Links of a neuron have to be added in increasing order of the other neuron.
+      * @param1 position of the other neuron
+      * @param2 weight
+      */
+    inline void appendLink(const unsigned long neuron, const double weight)
+    {m_linkNeurons.push_back(neuron); m_linkWeights.push_back(weight); m_rowStarts.back()++;}
+
+    /**
+      * Checks whether every link has a counterpart of the same weight.
+      * @return whether the weights are symmetric
+      */
+    bool isSymmetric() const;
+
+    inline unsigned long getLinkCount() const {return m_linkNeurons.size();}
+
+    double getWeight(const unsigned long, const unsigned long) const;
+
+    double calculatePotential(const unsigned long, const NeuronState&) const;
+
+    void calculateInputRange(const vector<double>&, vector<double>&, const unsigned long, const unsigned long) const;
+
+    void updatePotentials(const unsigned long, const double, vector<double>&) const;
+
+    void updatePotentialRange(const unsigned long, const double, vector<double>&, const unsigned long,
+                              const unsigned long) const;
+
+    void getLinks(const unsigned long, vector<unsigned long>&, vector<double>&) const;
+};
+
+
+/**
+  * A weight store for networks whose weights are all integers and whose links take only a few distinct weights.
+  * For every such weight, the neurons linked to a neuron by it are marked in a bit mask, so that a potential is
+  * the bias plus the weights multiplied by the numbers of active neurons in the masks.
+  */
+class BitMaskWeightStore: public WeightStore
+{
+private:
+    vector<double> m_biases; // weight[i][i] of every neuron
+    vector<double> m_levels; // distinct nonzero weights of links
+    unsigned long m_wordCount; // number of words of a mask
+    vector<uint64_t> m_masks; // mask of neuron i for level l starts at word (l*neuronCount+i)*wordCount
+
+    BitMaskWeightStore(const unsigned long, const vector<double>&);
+
+    inline uint64_t* getWritableMask(const unsigned long level, const unsigned long neuron)
+    {return &m_masks[(level*m_neuronCount+neuron)*m_wordCount];}
+
+public:
+    /**
+      * Creates a BitMaskWeightStore with the weights of another store, if they are integers taking at most
+      * MAX_WEIGHT_LEVELS distinct nonzero values off the diagonal and the masks do not take much more memory
+      * than the links themselves.
+      * @param1 weight store
+      * @return new weight store or NULL if the weights do not qualify
+      */
+    static BitMaskWeightStore* create(const WeightStore&);
+
+    inline unsigned long getLevelCount() const {return m_levels.size();}
+
+    inline double getLevel(const unsigned long level) const {return m_levels[level];}
+
+    inline double getBias(const unsigned long neuron) const {return m_biases[neuron];}
+
+    inline unsigned long getWordCount() const {return m_wordCount;}
+
+    /**
+      * Returns the mask of the neurons linked to a given neuron by the weight of a given level.
+      * @param1 level
+      * @param2 position of the neuron
+      * @return getWordCount() words, laid out as those of NeuronState, the neuron itself never set
+      */
+    inline const uint64_t* getMask(const unsigned long level, const unsigned long neuron) const
+    {return &m_masks[(level*m_neuronCount+neuron)*m_wordCount];}
+
+    double getWeight(const unsigned long, const unsigned long) const;
+
+    double calculatePotential(const unsigned long, const NeuronState&) const;
+
+    void calculateInputRange(const vector<double>&, vector<double>&, const unsigned long, const unsigned long) const;
+
+    void updatePotentials(const unsigned long, const double, vector<double>&) const;
+
+    void updatePotentialRange(const unsigned long, const double, vector<double>&, const unsigned long,
+                              const unsigned long) const;
+
+    void getLinks(const unsigned long, vector<unsigned long>&, vector<double>&) const;
+};
+
+
+/**
+  * A weight store for the travelling salesman problem that computes weights from the distances of cities on the fly.
+  * Neuron city*cityCount+step is active iff the city is visited in the given step.
+  * Weights are: delta/2 for the bias, -delta between neurons of the same city or of the same step,
+  * -distance between neurons of different cities in consecutive steps and 0 otherwise.
+  */
+class TSPWeightStore: public WeightStore
+{
+private:
+    unsigned long m_cityCount;
+    vector<float> m_distances; // distances of cities, row by row, as in TSPInstance
+    double m_delta; // penalty for visiting a city twice or two cities at once
+
+    inline double getDistance(const unsigned long from, const unsigned long to) const
+    {return m_distances[from*m_cityCount+to];}
+
+public:
+    /**
+      * Constructor of class TSPWeightStore
+      * @param1 number of cities
+      * @param2 distances of cities, row by row
+      * @param3 delta
+      */
+    TSPWeightStore(const unsigned long, const vector<float>&, const double);
+
+    inline unsigned long getCityCount() const {return m_cityCount;}
+
+    inline double getDelta() const {return m_delta;}
+
+    /**
+      * Copies the rows and columns of given cities from a distance matrix of the same cities, e.g. after they have
+      * moved. The links of their neurons change, the caller keeps the potentials in sync (see
+      * HopfieldNetwork::updateWeights).
+      * @param1 cities
+      * @param2 distances of all cities, row by row
+      */
+    void updateDistances(const vector<unsigned long>&, const vector<float>&);
+
+    double getWeight(const unsigned long, const unsigned long) const;
+
+    double calculatePotential(const unsigned long, const NeuronState&) const;
+
+    /**
+      * With fewer active neurons than neurons in the range or at most two per city, e.g. in the state of a tour,
+      * counts the active neurons of every city and step once and visits only the active cities of the neighbouring
+      * steps of a neuron, those of the prior step for a block of cities at once.
+      */
+    void calculatePotentialRange(const NeuronState&, vector<double>&, const unsigned long, const unsigned long) const;
+
+    void calculateInputRange(const vector<double>&, vector<double>&, const unsigned long, const unsigned long) const;
+
+    void updatePotentials(const unsigned long, const double, vector<double>&) const;
+
+    void updatePotentialRange(const unsigned long, const double, vector<double>&, const unsigned long,
+                              const unsigned long) const;
+
+    void getLinks(const unsigned long, vector<unsigned long>&, vector<double>&) const;
+};
+
+#endif // WEIGHTSTORE_H